@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Signed integer of arbitrary length. Only what is needed to rebuild
+// integers from their residues is here: multiply-add by a word, negation,
+// comparison and conversion to text or floating point.
+class BigInt {
+ public:
+  BigInt() = default;
+  BigInt(int64_t value);
+
+  // *this = *this * factor + addend, on the absolute value.
+  void MultiplyAdd(uint32_t factor, uint32_t addend);
+
+  bool IsZero() const;
+  bool IsNegative() const;
+  BigInt operator-() const;
+
+  std::string ToString() const;
+  long double ToLongDouble() const;
+
+  friend bool operator==(const BigInt& a, const BigInt& b) {
+    return a.negative_ == b.negative_ && a.limbs_ == b.limbs_;
+  }
+  friend bool operator!=(const BigInt& a, const BigInt& b) {
+    return !(a == b);
+  }
+  friend std::ostream& operator<<(std::ostream& out, const BigInt& a) {
+    return out << a.ToString();
+  }
+
+ private:
+  void Trim();
+
+  bool negative_ = false;
+  std::vector<uint32_t> limbs_;  // Absolute value, least significant first
+};
+
+inline BigInt::BigInt(int64_t value) {
+  negative_ = value < 0;
+  uint64_t abs_value = negative_ ? -static_cast<uint64_t>(value) : value;
+  while (abs_value > 0) {
+    limbs_.push_back(static_cast<uint32_t>(abs_value));
+    abs_value >>= 32;
+  }
+}
+
+inline void BigInt::MultiplyAdd(uint32_t factor, uint32_t addend) {
+  uint64_t carry = addend;
+  for (auto& limb: limbs_) {
+    uint64_t cur = static_cast<uint64_t>(limb) * factor + carry;
+    limb = static_cast<uint32_t>(cur);
+    carry = cur >> 32;
+  }
+  if (carry > 0) {
+    limbs_.push_back(static_cast<uint32_t>(carry));
+  }
+  Trim();
+}
+
+inline bool BigInt::IsZero() const {
+  return limbs_.empty();
+}
+
+inline bool BigInt::IsNegative() const {
+  return negative_;
+}
+
+inline BigInt BigInt::operator-() const {
+  BigInt ans = *this;
+  ans.negative_ = !ans.negative_;
+  ans.Trim();
+  return ans;
+}
+
+inline std::string BigInt::ToString() const {
+  if (IsZero()) {
+    return "0";
+  }
+  const uint32_t base = 1000000000;
+  auto limbs = limbs_;
+  std::vector<uint32_t> chunks;  // Base 10^9 digits, least significant first
+  while (!limbs.empty()) {
+    uint64_t rem = 0;
+    for (auto i = limbs.size(); i-- > 0;) {
+      uint64_t cur = (rem << 32) | limbs[i];
+      limbs[i] = static_cast<uint32_t>(cur / base);
+      rem = cur % base;
+    }
+    chunks.push_back(static_cast<uint32_t>(rem));
+    while (!limbs.empty() && limbs.back() == 0) {
+      limbs.pop_back();
+    }
+  }
+  std::string ans = negative_ ? "-" : "";
+  ans += std::to_string(chunks.back());
+  for (auto i = chunks.size() - 1; i-- > 0;) {
+    auto digits = std::to_string(chunks[i]);
+    ans += std::string(9 - digits.size(), '0') + digits;
+  }
+  return ans;
+}
+
+inline long double BigInt::ToLongDouble() const {
+  long double ans = 0;
+  for (auto i = limbs_.size(); i-- > 0;) {
+    ans = ans * 4294967296.0L + limbs_[i];
+  }
+  return negative_ ? -ans : ans;
+}
+
+inline void BigInt::Trim() {
+  while (!limbs_.empty() && limbs_.back() == 0) {
+    limbs_.pop_back();
+  }
+  if (limbs_.empty()) {
+    negative_ = false;
+  }
+}
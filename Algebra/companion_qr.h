@@ -0,0 +1,384 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <complex>
+#include <limits>
+#include <vector>
+#include "Matrix/matrix.h"
+#include "TimeMeasurer/scoped_profiler.h"
+#include "convergence_trace.h"
+#include "danilevski_eigenvalues.h"
+
+namespace __internal {
+
+// Unitary 2x2 rotation {{c, -conj(s)}, {s, conj(c)}} acting on indices
+// (k, k + 1). Products of such rotations stay in the same form, so no extra
+// diagonal is needed anywhere.
+template<class T>
+struct CoreRotation {
+  std::complex<T> c = 1;
+  std::complex<T> s = 0;
+};
+
+// Rotation g with g^H * (u, v)^T = (r, 0)^T.
+template<class T>
+CoreRotation<T> MakeCoreRotation(std::complex<T> u, std::complex<T> v) {
+  T r = std::hypot(std::abs(u), std::abs(v));
+  if (r == 0) {
+    return {1, 0};
+  }
+  return {u / r, v / r};
+}
+
+template<class T>
+CoreRotation<T> Adjoint(const CoreRotation<T>& g) {
+  return {std::conj(g.c), -g.s};
+}
+
+// The same rotation with its two indices swapped.
+template<class T>
+CoreRotation<T> Flipped(const CoreRotation<T>& g) {
+  return {std::conj(g.c), -std::conj(g.s)};
+}
+
+template<class T>
+CoreRotation<T> Fuse(const CoreRotation<T>& a, const CoreRotation<T>& b) {
+  return MakeCoreRotation(a.c * b.c - std::conj(a.s) * b.s,
+                          a.s * b.c + std::conj(a.c) * b.s);
+}
+
+template<class T>
+using Matrix3x3 = std::array<std::array<std::complex<T>, 3>, 3>;
+
+template<class T>
+void ApplyLeftAdjoint(Matrix3x3<T>& a, const CoreRotation<T>& g, int i) {
+  for (int j = 0; j < 3; j++) {
+    auto x = a[i][j];
+    auto y = a[i + 1][j];
+    a[i][j] = std::conj(g.c) * x + std::conj(g.s) * y;
+    a[i + 1][j] = -g.s * x + g.c * y;
+  }
+}
+
+template<class T>
+void ApplyRight(Matrix3x3<T>& a, const CoreRotation<T>& g, int j) {
+  for (int i = 0; i < 3; i++) {
+    auto x = a[i][j];
+    auto y = a[i][j + 1];
+    a[i][j] = x * g.c + y * g.s;
+    a[i][j + 1] = -x * std::conj(g.s) + y * std::conj(g.c);
+  }
+}
+
+// Real flops of one turnover: three rotations applied to a 3x3 matrix from
+// the right, two from the left and three rotations made.
+constexpr uint64_t kTurnoverFlops = 5 * 3 * 28 + 3 * 20;
+
+// a(0, 1) * b(1, 2) * c(0, 1) = d(1, 2) * e(0, 1) * f(1, 2)
+template<class T>
+std::array<CoreRotation<T>, 3> TurnoverDown(const CoreRotation<T>& a,
+                                            const CoreRotation<T>& b,
+                                            const CoreRotation<T>& c) {
+  Matrix3x3<T> u{};
+  for (int i = 0; i < 3; i++) {
+    u[i][i] = 1;
+  }
+  ApplyRight(u, a, 0);
+  ApplyRight(u, b, 1);
+  ApplyRight(u, c, 0);
+  auto d = MakeCoreRotation(u[1][0], u[2][0]);
+  ApplyLeftAdjoint(u, d, 1);
+  auto e = MakeCoreRotation(u[0][0], u[1][0]);
+  ApplyLeftAdjoint(u, e, 0);
+  auto f = MakeCoreRotation(u[1][1], u[2][1]);
+  return {d, e, f};
+}
+
+// a(1, 2) * b(0, 1) * c(1, 2) = d(0, 1) * e(1, 2) * f(0, 1)
+template<class T>
+std::array<CoreRotation<T>, 3> TurnoverUp(const CoreRotation<T>& a,
+                                          const CoreRotation<T>& b,
+                                          const CoreRotation<T>& c) {
+  auto[d, e, f] = TurnoverDown(Flipped(a), Flipped(b), Flipped(c));
+  return {Flipped(d), Flipped(e), Flipped(f)};
+}
+
+// Entries of the descending product g[0] * g[1] * ... * g[k - 1] near the
+// main diagonal. `adjoint` reads every factor as g[i]^H.
+template<class T>
+class DescendingRotations {
+ public:
+  DescendingRotations(const std::vector<CoreRotation<T>>& g, bool adjoint) :
+      g_(g), adjoint_(adjoint) {}
+
+  std::complex<T> Sub(int k) const {  // (k + 1, k)
+    return Get(k).s;
+  }
+
+  std::complex<T> Diag(int k) const {  // (k, k)
+    return std::conj(Get(k - 1).c) * Get(k).c;
+  }
+
+  std::complex<T> Super(int k) const {  // (k, k + 1)
+    return -std::conj(Get(k - 1).c) * std::conj(Get(k).s) * Get(k + 1).c;
+  }
+
+ private:
+  CoreRotation<T> Get(int k) const {
+    if (k < 0 || k >= g_.size()) {
+      return {};
+    }
+    return adjoint_ ? Adjoint(g_[k]) : g_[k];
+  }
+
+  const std::vector<CoreRotation<T>>& g_;
+  bool adjoint_;
+};
+
+// Companion matrix of x^n - p[0] * x^(n - 1) - ... - p[n - 1] kept as
+// A = Q * R, where Q = q[0] * ... * q[n - 2] and R is the leading n x n block
+// of the upper triangular (n + 1) x (n + 1) unitary-plus-rank-one matrix
+// c[n - 1] * ... * c[0] * (b[0] * ... * b[n - 1] + e_0 * y^H).
+// Every entry used by the iteration is recovered from the rotations in O(1),
+// so a QR step costs O(n) and all roots cost O(n^2).
+template<class T>
+class CompanionFactorization {
+ public:
+  explicit CompanionFactorization(const std::vector<T>& p) :
+      n_(p.size()), q_(n_ - 1), c_(n_), b_(n_) {
+    for (auto& it: q_) {
+      it = {0, 1};
+    }
+    T sigma = n_ % 2 == 1 ? 1 : -1;
+    std::vector<std::complex<T>> x(n_ + 1);
+    for (int i = 0; i + 1 < n_; i++) {
+      x[i] = p[n_ - 2 - i];
+    }
+    x[n_ - 1] = sigma * p[n_ - 1];
+    x[n_] = 1;
+    std::complex<T> tail = x[n_];
+    for (int i = n_ - 1; i >= 0; i--) {
+      c_[i] = MakeCoreRotation(x[i], tail);
+      tail = std::hypot(std::abs(x[i]), std::abs(tail));
+    }
+    for (int i = 0; i < n_; i++) {
+      b_[i] = Adjoint(c_[i]);
+    }
+    b_[n_ - 1] = Fuse(b_[n_ - 1], CoreRotation<T>{0, -1});
+  }
+
+  std::complex<T> R(int i, int j) const {
+    DescendingRotations<T> b(b_, false);
+    DescendingRotations<T> ch(c_, true);
+    if (i == j) {
+      return b.Sub(j) / ch.Sub(j);
+    }
+    if (i + 1 == j) {
+      return (b.Diag(j) - ch.Diag(j) * R(j, j)) / ch.Sub(j - 1);
+    }
+    return (b.Super(j - 1) - ch.Diag(j - 1) * R(j - 1, j)
+        - ch.Super(j - 1) * R(j, j)) / ch.Sub(j - 2);
+  }
+
+  // Only for j >= i - 1 and j <= i + 1, which is all the iteration needs.
+  std::complex<T> A(int i, int j) const {
+    DescendingRotations<T> q(q_, false);
+    std::complex<T> ans;
+    if (i > 0 && q.Sub(i - 1) != std::complex<T>()) {
+      ans += q.Sub(i - 1) * R(i - 1, j);
+    }
+    if (i <= j) {
+      ans += q.Diag(i) * R(i, j);
+    }
+    if (i < j) {
+      ans += q.Super(i) * R(i + 1, j);
+    }
+    return ans;
+  }
+
+  // Sets negligible subdiagonal rotations of Q to diagonal ones.
+  void Deflate(int lo, int hi, T eps) {
+    for (int k = lo; k < hi; k++) {
+      if (std::abs(q_[k].s) < eps) {
+        q_[k] = {q_[k].c / std::abs(q_[k].c), 0};
+      }
+    }
+  }
+
+  bool IsDeflated(int k) const {
+    return q_[k].s == std::complex<T>();
+  }
+
+  // One implicit single-shift QR step on the active block [lo, hi].
+  void Step(int lo, int hi, std::complex<T> shift) {
+    // Three turnovers per position, each reading and writing two rotations.
+    COUNT_WORK(3 * kTurnoverFlops * (hi - lo),
+               3 * 4 * sizeof(CoreRotation<T>) * (hi - lo));
+    auto g = MakeCoreRotation(A(lo, lo) - shift, A(lo + 1, lo));
+    auto left = g;
+    if (lo > 0) {
+      left.s *= std::conj(q_[lo - 1].c);
+    }
+    q_[lo] = Fuse(Adjoint(left), q_[lo]);
+    for (int k = lo; k < hi - 1; k++) {
+      auto[next, q1, q2] = TurnoverDown(q_[k], q_[k + 1], PassThroughR(g, k));
+      q_[k] = q1;
+      q_[k + 1] = q2;
+      g = next;
+    }
+    auto last = PassThroughR(g, hi - 1);
+    if (hi < n_ - 1) {
+      last.s *= q_[hi].c;
+    }
+    q_[hi - 1] = Fuse(q_[hi - 1], last);
+  }
+
+ private:
+  // R * g = g' * R' for g acting on columns (k, k + 1).
+  CoreRotation<T> PassThroughR(const CoreRotation<T>& g, int k) {
+    auto[g1, b1, b2] = TurnoverDown(b_[k], b_[k + 1], g);
+    b_[k] = b1;
+    b_[k + 1] = b2;
+    auto[g2, c1, c2] = TurnoverUp(c_[k + 1], c_[k], g1);
+    c_[k + 1] = c1;
+    c_[k] = c2;
+    return g2;
+  }
+
+  int n_;
+  std::vector<CoreRotation<T>> q_;
+  std::vector<CoreRotation<T>> c_;
+  std::vector<CoreRotation<T>> b_;
+};
+
+template<class T>
+std::pair<std::complex<T>, std::complex<T>> Eigenvalues2x2(
+    std::complex<T> a, std::complex<T> b,
+    std::complex<T> c, std::complex<T> d) {
+  auto half_trace = (a + d) / T(2);
+  auto root = std::sqrt((a - d) * (a - d) / T(4) + b * c);
+  return {half_trace + root, half_trace - root};
+}
+
+}
+
+// Roots of x^n - p[0] * x^(n - 1) - ... - p[n - 1], i.e. eigenvalues of the
+// Frobenius block with first row p, by QR iterations on the companion matrix
+// that keep its unitary-plus-rank-one structure. The trace gets the last
+// subdiagonal entry of the active block every step and each root as a
+// deflation event when it splits off.
+template<class T>
+std::vector<std::complex<T>> CompanionQrRoots(
+    const std::vector<T>& p,
+    int* iters = nullptr,
+    int max_iter = 1000,
+    ConvergenceTrace* trace = nullptr) {
+  PROFILE_ZONE("CompanionQrRoots");
+  int n = p.size();
+  if (iters) {
+    *iters = 0;
+  }
+  if (n == 0) {
+    return {};
+  }
+  if (n == 1) {
+    return {p[0]};
+  }
+  auto eps = std::numeric_limits<T>::epsilon();
+  __internal::CompanionFactorization<T> f(p);
+  std::vector<std::complex<T>> ans;
+  ans.reserve(n);
+  int iter = 0;
+  int since_deflation = 0;
+  int hi = n - 1;
+  while (hi >= 0) {
+    f.Deflate(0, hi, eps);
+    int lo = hi;
+    while (lo > 0 && !f.IsDeflated(lo - 1)) {
+      lo--;
+    }
+    if (lo == hi) {
+      ans.push_back(f.A(hi, hi));
+      if (trace) {
+        trace->Record(TraceSolver::kCompanionQr, TraceEvent::kDeflation,
+                      iter, hi, std::complex<double>(ans.back()));
+      }
+      hi--;
+      since_deflation = 0;
+      continue;
+    }
+    if (lo + 1 == hi) {
+      auto[e1, e2] = __internal::Eigenvalues2x2(
+          f.A(lo, lo), f.A(lo, hi), f.A(hi, lo), f.A(hi, hi));
+      ans.push_back(e1);
+      ans.push_back(e2);
+      if (trace) {
+        trace->Record(TraceSolver::kCompanionQr, TraceEvent::kDeflation,
+                      iter, lo, std::complex<double>(e1));
+        trace->Record(TraceSolver::kCompanionQr, TraceEvent::kDeflation,
+                      iter, hi, std::complex<double>(e2));
+      }
+      hi -= 2;
+      since_deflation = 0;
+      continue;
+    }
+    if (iter == max_iter) {
+      if (iters) {
+        *iters = -1;
+      }
+      return ans;
+    }
+    auto[e1, e2] = __internal::Eigenvalues2x2(
+        f.A(hi - 1, hi - 1), f.A(hi - 1, hi), f.A(hi, hi - 1), f.A(hi, hi));
+    auto shift = std::abs(e1 - f.A(hi, hi)) < std::abs(e2 - f.A(hi, hi))
+                 ? e1 : e2;
+    if (++since_deflation % 16 == 0) {
+      shift = f.A(hi, hi) + std::abs(f.A(hi, hi - 1))
+          * std::complex<T>(0.75, 0.5);
+    }
+    f.Step(lo, hi, shift);
+    iter++;
+    if (trace) {
+      trace->Record(TraceSolver::kCompanionQr, TraceEvent::kSubdiagonal,
+                    iter, hi - 1,
+                    static_cast<double>(std::abs(f.A(hi, hi - 1))));
+    }
+  }
+  if (iters) {
+    *iters = iter + 1;
+  }
+  return ans;
+}
+
+// Eigenvalues of a matrix in Frobenius form, block by block, without going
+// through the coefficients of the characteristic polynomial.
+template<class T>
+std::vector<std::vector<std::complex<T>>> DanilevskiCompanionQr(
+    const Matrix<T>& a,
+    std::vector<int>* matrix_sizes = nullptr,
+    int* iters = nullptr,
+    int max_iter = 1000,
+    ConvergenceTrace* trace = nullptr) {
+  std::vector<std::vector<std::complex<T>>> ans;
+  if (iters) {
+    *iters = 0;
+  }
+  int shift = 0;
+  for (auto size: __internal::FrobeniusBlockSizes(a)) {
+    if (matrix_sizes) {
+      matrix_sizes->push_back(size);
+    }
+    std::vector<T> p(size);
+    for (int j = 0; j < size; j++) {
+      p[j] = a(shift, shift + j);
+    }
+    int block_iters = 0;
+    ans.push_back(CompanionQrRoots(p, &block_iters, max_iter, trace));
+    if (iters && *iters >= 0) {
+      *iters = block_iters < 0 ? -1 : *iters + block_iters;
+    }
+    shift += size;
+  }
+  return ans;
+}
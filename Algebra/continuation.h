@@ -0,0 +1,238 @@
+#pragma once
+
+#include <cmath>
+#include <complex>
+#include <limits>
+#include <vector>
+#include "Matrix/matrix.h"
+#include "Matrix/counter_random.h"
+#include "TimeMeasurer/scoped_profiler.h"
+#include "convergence_trace.h"
+#include "euclidean_norm.h"
+#include "gauss.h"
+#include "hessenberg_form.h"
+#include "qr_algorithm.h"
+#include "subspace_iteration.h"
+
+namespace __internal {
+
+// Rayleigh quotient iteration from the unit vector x: x = (a - mu)^-1 x,
+// mu = x^T a x, until |a x - mu x| or the change of mu is at most eps.
+// Converges to the eigenvalue next to the starting quotient, quadratically,
+// for a symmetric a cubically. Near convergence a - mu is singular to
+// working precision and a solve can make x worse: a small residual that
+// grows again keeps the x before. Returns the number of solves, -1 if
+// max_iters were not enough.
+template<class T>
+int RayleighQuotientIteration(const Matrix<T>& a, Matrix<T>& x, T& mu,
+                              int max_iters, T eps) {
+  int n = a.Rows();
+  auto ax = a * x;
+  mu = x.ScalarProduct(ax);
+  T residual = EuclideanNorm<T>(ax - mu * x);
+  for (int iter = 1; iter <= max_iters; iter++) {
+    Matrix<T> shifted = a;
+    for (int i = 0; i < n; i++) {
+      shifted(i, i) -= mu;
+    }
+    auto y = GaussSolve(shifted, x).first;
+    T norm = EuclideanNorm<T>(y);
+    // mu is an eigenvalue to working precision and x its vector.
+    if (!std::isfinite(norm)) {
+      return iter;
+    }
+    y /= norm;
+    auto ay = a * y;
+    T next_mu = y.ScalarProduct(ay);
+    T next_residual = EuclideanNorm<T>(ay - next_mu * y);
+    bool small = residual <= std::sqrt(eps) * (std::abs(mu) + 1);
+    if (small && next_residual >= residual) {
+      return iter;
+    }
+    T change = std::abs(next_mu - mu);
+    x = std::move(y);
+    mu = next_mu;
+    residual = next_residual;
+    if (change <= eps || residual <= eps) {
+      return iter;
+    }
+  }
+  return -1;
+}
+
+}
+
+// Solver state for a sequence of slowly varying matrices A(t): Dominant
+// finds what SubspaceIteration does, starting from what the previous call
+// left. A single real dominant eigenvalue is followed by Rayleigh quotient
+// iteration from the last vector, a few solves instead of a power method;
+// otherwise the subspace iteration starts from the last block. A refined
+// eigenvalue is checked against the rest of the spectrum: the block behind
+// the vector is iterated with the vector deflated out until its largest
+// Ritz value settles, and if that is as large, the eigenvalues have crossed
+// and the subspace iteration takes over. The same steps keep the rest of
+// the block following the next eigenvectors, so they are few. A relative
+// drift |A - A_prev| / |A_prev| over max_drift in Frobenius norm drops the
+// state and starts from the random block again, as does a warm start that
+// doesn't converge.
+template<class T>
+class EigenContinuation {
+ public:
+  explicit EigenContinuation(T max_drift = 0.1, int block_size = 4)
+      : max_drift_(max_drift), block_size_(block_size) {
+    if (block_size <= 0) {
+      throw std::invalid_argument("Block should have at least one vector");
+    }
+  }
+
+  // *iters is the number of solves and check multiplications after a
+  // refinement and of block multiplications otherwise, -1 when max_iters
+  // were not enough.
+  std::vector<std::pair<std::complex<T>, Matrix<std::complex<T>>>> Dominant(
+      const Matrix<T>& a,
+      int* iters = nullptr,
+      int max_iters = 100,
+      ConvergenceTrace* trace = nullptr) {
+    PROFILE_ZONE("EigenContinuation::Dominant");
+    if (!a.IsSquare()) {
+      throw std::invalid_argument(
+          "Matrix of size " + PairToString(a.Size()) + " is not square.");
+    }
+    T eps = Matrix<T>::GetEps();
+    int n = a.Rows();
+    int iter = -1;
+    restarted_ = !(previous_.Size() == a.Size() && block_.Rows() == n &&
+                   EuclideanNorm<T>(a - previous_) <=
+                       max_drift_ * EuclideanNorm<T>(previous_));
+    previous_ = a;
+
+    if (!restarted_ && refinable_) {
+      PROFILE_ZONE("Rayleigh quotient iteration");
+      Matrix<T> x = block_.Col(0);
+      T mu = 0;
+      iter = __internal::RayleighQuotientIteration(a, x, mu, kMaxSolves, eps);
+      int steps = 0;
+      if (iter >= 0 && StaysDominant(a, x, mu, max_iters, eps, &steps)) {
+        iter += steps;
+        if (trace) {
+          trace->Record(TraceSolver::kSubspaceIteration,
+                        TraceEvent::kEigenvalue, iter, 0,
+                        std::complex<double>(mu));
+        }
+        if (iters) {
+          *iters = iter;
+        }
+        return {std::make_pair(std::complex<T>(mu), x.ToComplex())};
+      }
+    }
+
+    std::vector<std::pair<std::complex<T>, Matrix<std::complex<T>>>> ans;
+    if (!restarted_) {
+      ans = __internal::SubspaceIterationFrom(a, block_, &iter, max_iters, eps,
+                                              trace);
+      restarted_ = iter < 0;
+    }
+    if (restarted_) {
+      block_ = CounterRandomMatrix<T>(n, std::min(block_size_, n), -1, 1,
+                                      0x5eed);
+      __internal::Orthonormalize(block_);
+      ans = __internal::SubspaceIterationFrom(a, block_, &iter, max_iters, eps,
+                                              trace);
+    }
+    // The dominant vector goes first in the block for the next call.
+    refinable_ = iter >= 0 && ans.size() == 1 && ans[0].first.imag() == 0 &&
+                 block_.Cols() > 1;
+    if (refinable_) {
+      auto x = block_.Col(0);
+      for (int i = 0; i < n; i++) {
+        x(i) = ans[0].second(i).real();
+      }
+      __internal::Orthonormalize(block_);
+    }
+    if (iters) {
+      *iters = iter;
+    }
+    return ans;
+  }
+
+  // Whether the last call started from scratch.
+  bool Restarted() const {
+    return restarted_;
+  }
+
+  void Reset() {
+    previous_ = Matrix<T>();
+    block_ = Matrix<T>();
+    refinable_ = false;
+  }
+
+ private:
+  static constexpr int kMaxSolves = 10;
+  static constexpr int kSmallQrIters = 100000;
+  static constexpr T kRatioTolerance = 0.1;
+
+  // Whether mu is still the only eigenvalue of the largest modulus. With
+  // the unit eigenvector x in front of the block, the rest of it runs
+  // subspace iteration on a restricted to the complement of x, whose
+  // eigenvalues are those of a but mu: x is the first vector of a Schur
+  // basis. The largest of its Ritz values converges linearly: once the
+  // ratios of its last changes agree on q, the limit is within d q / (1 - q)
+  // of it for the last change d, taken twice for safety, and a bound below
+  // |mu| keeps mu dominant. Otherwise the value is compared with mu when it changes by at
+  // most eps; a QR failure or max_iters steps count as a crossing. *steps is
+  // the number of multiplications.
+  bool StaysDominant(const Matrix<T>& a, const Matrix<T>& x, T mu,
+                     int max_iters, T eps, int* steps) {
+    int n = a.Rows();
+    int p = block_.Cols();
+    block_.Col(0).Assign(x);
+    __internal::Orthonormalize(block_);
+    T tolerance = std::max(Matrix<T>::GetEps(),
+                           std::sqrt(std::numeric_limits<T>::epsilon()) *
+                               std::abs(mu));
+    T prev = std::numeric_limits<T>::infinity();
+    T prev_change = std::numeric_limits<T>::infinity();
+    T prev_q = std::numeric_limits<T>::infinity();
+    for (*steps = 1; *steps <= max_iters; ++*steps) {
+      auto rest = block_.SubMatrix(0, 1, n, p - 1);
+      auto z = a * rest;
+      // Ritz values close in modulus take the unshifted QR algorithm long,
+      // but the matrix is tiny.
+      auto ritz = QrAlgorithm(ReflectionsHessenberg(rest.Transposed() * z),
+                              nullptr, kSmallQrIters);
+      if (ritz.empty()) {
+        return false;
+      }
+      T largest = 0;
+      for (auto value: ritz) {
+        largest = std::max<T>(largest, std::abs(value));
+      }
+      rest.Assign(z);
+      __internal::Orthonormalize(block_);
+      T change = std::abs(largest - prev);
+      if (change <= eps) {
+        return largest < std::abs(mu) - tolerance;
+      }
+      T q = change / prev_change;
+      bool steady = std::abs(q - prev_q) <= kRatioTolerance * q;
+      if (steady && q < 1 &&
+          largest + change + 2 * change * q / (1 - q) <
+              std::abs(mu) - tolerance) {
+        return true;
+      }
+      prev = largest;
+      prev_change = change;
+      prev_q = q;
+    }
+    return false;
+  }
+
+  T max_drift_;
+  int block_size_;
+  bool restarted_ = true;
+  Matrix<T> previous_;
+  Matrix<T> block_;
+  // Rayleigh quotient iteration applies: the dominant vector is the first
+  // column of block_.
+  bool refinable_ = false;
+};
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <algorithm>
+#include <complex>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+enum class TraceSolver : uint8_t {
+  kPowerMethod1,
+  kPowerMethod2,
+  kPowerMethod3,
+  kQrAlgorithm,
+  kCompanionQr,
+  kSubspaceIteration,
+};
+
+enum class TraceEvent : uint8_t {
+  kEigenvalue,   // Current estimate, index tells which one
+  kResidual,     // Change of the estimate or another convergence measure
+  kSubdiagonal,  // |a(index + 1, index)| after a sweep
+  kDeflation,    // a(index + 1, index) became negligible
+};
+
+struct TraceRecord {
+  double re;
+  double im;
+  int32_t iteration;
+  uint16_t index;
+  TraceEvent event;
+  TraceSolver solver;
+};
+
+// Fixed size ring buffer of per-iteration solver data. Solvers take an
+// optional pointer to it and record nothing when it is null; once the buffer
+// is full the oldest records are overwritten.
+class ConvergenceTrace {
+ public:
+  explicit ConvergenceTrace(size_t capacity = 1 << 16);
+
+  void Record(TraceSolver solver,
+              TraceEvent event,
+              int iteration,
+              int index,
+              std::complex<double> value);
+  void Clear();
+
+  size_t Size() const;
+  size_t Capacity() const;
+  uint64_t Dropped() const;
+  // Oldest first.
+  const TraceRecord& operator[](size_t i) const;
+
+  void Write(std::ostream& out) const;
+  static ConvergenceTrace Read(std::istream& in);
+
+ private:
+  std::vector<TraceRecord> records_;
+  uint64_t total_ = 0;
+};
+
+inline ConvergenceTrace::ConvergenceTrace(size_t capacity)
+    : records_(capacity) {
+  if (capacity == 0) {
+    throw std::invalid_argument("Trace capacity should be positive");
+  }
+}
+
+inline void ConvergenceTrace::Record(TraceSolver solver,
+                                     TraceEvent event,
+                                     int iteration,
+                                     int index,
+                                     std::complex<double> value) {
+  records_[total_ % records_.size()] = {
+      value.real(), value.imag(), iteration, static_cast<uint16_t>(index),
+      event, solver};
+  total_++;
+}
+
+inline void ConvergenceTrace::Clear() {
+  total_ = 0;
+}
+
+inline size_t ConvergenceTrace::Size() const {
+  return std::min<uint64_t>(total_, records_.size());
+}
+
+inline size_t ConvergenceTrace::Capacity() const {
+  return records_.size();
+}
+
+inline uint64_t ConvergenceTrace::Dropped() const {
+  return total_ - Size();
+}
+
+inline const TraceRecord& ConvergenceTrace::operator[](size_t i) const {
+  return records_[(Dropped() + i) % records_.size()];
+}
+
+// Layout: "CTRC", record size as uint32, record count and dropped count as
+// uint64, then the records oldest first, all in native byte order.
+inline void ConvergenceTrace::Write(std::ostream& out) const {
+  uint32_t record_size = sizeof(TraceRecord);
+  uint64_t header[2]{Size(), Dropped()};
+  out.write("CTRC", 4);
+  out.write(reinterpret_cast<const char*>(&record_size), sizeof(record_size));
+  out.write(reinterpret_cast<const char*>(header), sizeof(header));
+  auto begin = Dropped() % records_.size();
+  auto first = std::min(Size(), records_.size() - begin);
+  out.write(reinterpret_cast<const char*>(records_.data() + begin),
+            first * sizeof(TraceRecord));
+  out.write(reinterpret_cast<const char*>(records_.data()),
+            (Size() - first) * sizeof(TraceRecord));
+}
+
+inline ConvergenceTrace ConvergenceTrace::Read(std::istream& in) {
+  char magic[4];
+  uint32_t record_size;
+  uint64_t header[2];
+  in.read(magic, 4);
+  in.read(reinterpret_cast<char*>(&record_size), sizeof(record_size));
+  in.read(reinterpret_cast<char*>(header), sizeof(header));
+  if (!in || std::string(magic, 4) != "CTRC" ||
+      record_size != sizeof(TraceRecord)) {
+    throw std::runtime_error("Not a convergence trace");
+  }
+  ConvergenceTrace trace(std::max<uint64_t>(header[0], 1));
+  in.read(reinterpret_cast<char*>(trace.records_.data()),
+          header[0] * sizeof(TraceRecord));
+  if (!in) {
+    throw std::runtime_error("Truncated convergence trace");
+  }
+  trace.total_ = header[0];
+  return trace;
+}
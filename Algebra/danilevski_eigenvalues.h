@@ -19,31 +19,36 @@ std::vector<T> DanilevskiPolynomial(const Matrix<T>& a) {
   return ans;
 }
 
-}
-
 template<class T>
-std::vector<std::vector<T>> DanilevskiPolynomial(Matrix<T> a,
-                                                 std::vector<int>* matrix_sizes = nullptr) {
+std::vector<int> FrobeniusBlockSizes(const Matrix<T>& a) {
   int last = 0;
-  std::vector<std::vector<T>> ans;
+  std::vector<int> sizes;
   auto n = a.Rows();
   for (int i = 0; i < n - 1; i++) {
     // std::cerr << a(i + 1, i) << '\n';
     if (std::abs(a(i + 1, i)) < 1e-8) {
-      ans.push_back(__internal::DanilevskiPolynomial(
-          a.SubMatrix(last, last, i - last + 1, i - last + 1)));
-      if (matrix_sizes) {
-        matrix_sizes->push_back(i - last + 1);
-      }
+      sizes.push_back(i - last + 1);
       last = i + 1;
     }
   }
-  // if (last != n - 1) {
+  sizes.push_back(n - last);
+  return sizes;
+}
+
+}
+
+template<class T>
+std::vector<std::vector<T>> DanilevskiPolynomial(Matrix<T> a,
+                                                 std::vector<int>* matrix_sizes = nullptr) {
+  std::vector<std::vector<T>> ans;
+  int shift = 0;
+  for (auto size: __internal::FrobeniusBlockSizes(a)) {
     if (matrix_sizes) {
-      matrix_sizes->push_back(a.SubMatrix(last, last, -1, -1).Rows());
+      matrix_sizes->push_back(size);
     }
     ans.push_back(__internal::DanilevskiPolynomial(
-        a.SubMatrix(last, last, -1, -1)));
-  // }
+        a.SubMatrix(shift, shift, size, size)));
+    shift += size;
+  }
   return ans;
 }
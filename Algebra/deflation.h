@@ -0,0 +1,187 @@
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "Matrix/matrix.h"
+#include "Matrix/counter_random.h"
+#include "TimeMeasurer/scoped_profiler.h"
+#include "convergence_trace.h"
+#include "euclidean_norm.h"
+#include "power_iteration_method.h"
+
+enum class DeflationKind {
+  kHotelling,  // a - lambda v v^T, keeps a symmetric a symmetric
+  kWielandt,   // a - v r^T / v_i with r the row i of a, |v_i| largest
+};
+
+namespace __internal {
+
+// a - sum_j w_j x_j^T, x_j^T w_j = lambda_j, never formed: a product is one
+// product by a and 4 n rank more flops. Removing an eigenpair (lambda, w) of
+// the operator this way leaves the rest of its eigenvalues where they were
+// and lambda goes to 0 (Wielandt's theorem), whatever x is.
+template<class T>
+class DeflatedOperator {
+ public:
+  DeflatedOperator(const Matrix<T>& a, int max_rank)
+      : a_(a), w_(max_rank, a.Rows()), x_(max_rank, a.Rows()) {}
+
+  int Rows() const {
+    return a_.Rows();
+  }
+
+  std::pair<int, int> Size() const {
+    return a_.Size();
+  }
+
+  bool IsSquare() const {
+    return a_.IsSquare();
+  }
+
+  // Removes the eigenpair (lambda, w) of the current operator.
+  void Deflate(T lambda, const Matrix<T>& w, DeflationKind kind) {
+    if (rank_ == w_.Rows()) {
+      throw std::runtime_error("Operator is deflated " +
+                               std::to_string(rank_) + " times already");
+    }
+    int n = Rows();
+    T norm = EuclideanNorm<T>(w);
+    for (int i = 0; i < n; i++) {
+      w_(rank_, i) = w(i) / norm;
+    }
+    if (kind == DeflationKind::kHotelling) {
+      for (int i = 0; i < n; i++) {
+        x_(rank_, i) = lambda * w_(rank_, i);
+      }
+    } else {
+      int row = 0;
+      for (int i = 1; i < n; i++) {
+        if (std::abs(w_(rank_, i)) > std::abs(w_(rank_, row))) {
+          row = i;
+        }
+      }
+      // Row of the current operator, which the update makes zero.
+      for (int i = 0; i < n; i++) {
+        T entry = a_(row, i);
+        for (int j = 0; j < rank_; j++) {
+          entry -= w_(j, row) * x_(j, i);
+        }
+        x_(rank_, i) = entry / w_(rank_, row);
+      }
+    }
+    lambdas_.push_back(lambda);
+    rank_++;
+  }
+
+  // Takes an eigenvector z for mu of the operator back to an eigenvector of
+  // a, one update at a time: if B = C - w x^T, then for B z = mu z
+  // C ((mu - lambda) z + (x^T z) w) = mu ((mu - lambda) z + (x^T z) w).
+  Matrix<T> Restore(T mu, Matrix<T> z) const {
+    int n = Rows();
+    for (int j = rank_ - 1; j >= 0; j--) {
+      T product = 0;
+      for (int i = 0; i < n; i++) {
+        product += x_(j, i) * z(i);
+      }
+      for (int i = 0; i < n; i++) {
+        z(i) = (mu - lambdas_[j]) * z(i) + product * w_(j, i);
+      }
+      z /= EuclideanNorm<T>(z);
+    }
+    COUNT_WORK(6 * uint64_t(n) * rank_, 3 * sizeof(T) * uint64_t(n) * rank_);
+    return z;
+  }
+
+  friend Matrix<T> operator*(const DeflatedOperator& op, const Matrix<T>& u) {
+    auto ans = op.a_ * u;
+    int n = op.Rows();
+    if (n == 0 || op.rank_ == 0) {
+      return ans;
+    }
+    const T* v = &u.At(0, 0);
+    size_t stride = u.RowStride();
+    T* out = &ans.At(0, 0);  // A fresh column, contiguous
+    for (int j = 0; j < op.rank_; j++) {
+      const T* x = &op.x_.At(j, 0);
+      const T* w = &op.w_.At(j, 0);
+      T product = 0;
+      for (int i = 0; i < n; i++) {
+        product += x[i] * v[i * stride];
+      }
+      for (int i = 0; i < n; i++) {
+        out[i] -= product * w[i];
+      }
+    }
+    COUNT_WORK(4 * uint64_t(n) * op.rank_,
+               2 * sizeof(T) * uint64_t(n) * op.rank_);
+    return ans;
+  }
+
+ private:
+  const Matrix<T>& a_;
+  Matrix<T> w_;
+  Matrix<T> x_;
+  std::vector<T> lambdas_;
+  int rank_ = 0;
+};
+
+}
+
+// Eigenpairs of the count eigenvalues of a of the largest modulus, by the
+// power method (force_method 0) and deflation: every eigenpair found is
+// removed from the operator by a rank one update and the next stage runs on
+// what is left. The stages start from the residual a u - lambda u of the last
+// iterate of the previous one, which is made of the next eigenvectors
+// already, so the whole costs about count single solves. Hotelling's
+// deflation keeps the eigenvectors of a symmetric a, Wielandt's works for any
+// a; the vectors are taken back to ones of a either way. The eigenvalues
+// have to be real and apart in modulus: the first stage that doesn't converge
+// ends the search, with *iters -1. Otherwise *iters is the total number of
+// iterations. No acceleration here: an extrapolated eigenvalue converges
+// ahead of its vector, and a loose vector spoils every later stage.
+template<class T>
+std::vector<std::pair<T, Matrix<T>>> DeflatedPowerMethod(
+    const Matrix<T>& a,
+    int count,
+    int* iters = nullptr,
+    int max_iters = 1000,
+    DeflationKind kind = DeflationKind::kHotelling,
+    ConvergenceTrace* trace = nullptr) {
+  PROFILE_ZONE("DeflatedPowerMethod");
+  if (!a.IsSquare()) {
+    throw std::invalid_argument(
+        "Matrix of size " + PairToString(a.Size()) + " is not square.");
+  }
+  int n = a.Rows();
+  count = std::min(count, n);
+  __internal::DeflatedOperator<T> op(a, std::max(count, 0));
+  Matrix<T> start(n, 1);
+  if (n > 0) {
+    start(0) = 1;
+  }
+  std::vector<std::pair<T, Matrix<T>>> ans;
+  int total = 0;
+  for (int stage = 0; stage < count; stage++) {
+    int stage_iters = 0;
+    auto [lambda, u] = __internal::PowerMethodEigenvalues1(
+        op, start, &stage_iters, max_iters, trace);
+    if (stage_iters < 0) {
+      total = -1;
+      break;
+    }
+    total += stage_iters;
+    ans.emplace_back(lambda, op.Restore(lambda, u));
+    op.Deflate(lambda, u, kind);
+    // A start that cancelled out entirely is replaced by a random one.
+    start = op * u;
+    if (EuclideanNorm<T>(start) <=
+        std::sqrt(std::numeric_limits<T>::epsilon()) * std::abs(lambda)) {
+      start = CounterRandomMatrix<T>(n, 1, -1, 1, 0x5eed, stage);
+    }
+  }
+  if (iters) {
+    *iters = total;
+  }
+  return ans;
+}
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "Matrix/matrix.h"
+#include "Matrix/split_complex.h"
+#include "euclidean_norm.h"
 #include "gauss.h"
 #include "lu_decompose.h"
 
@@ -24,24 +26,22 @@ std::pair<std::complex<T>,
   return SolveQuadraticEquation(b / b, b, c);
 }
 
+namespace __internal {
+
 template<class T>
-std::vector<Matrix<std::complex<T>>> FindEigenvectorsByValues(
-    const Matrix<std::complex<T>>& matrix,
+std::vector<Matrix<std::complex<T>>> SplitEigenvectorsByValues(
+    const SplitComplexMatrix<T>& matrix,
     const std::vector<std::complex<T>>& values) {
-  Matrix<std::complex<T>> a(matrix.Rows(), matrix.Cols());
-  Matrix<std::complex<T>> b(matrix.Rows(), 1);
+  SplitComplexMatrix<T> b(matrix.Rows(), 1);
   std::vector<Matrix<std::complex<T>>> ans;
 
   for (auto value: values) {
-    for (int i = 0; i < matrix.Rows(); i++) {
-      for (int j = 0; j < matrix.Cols(); j++) {
-        a(i, j) = matrix(i, j);
-        if (i == j) {
-          a(i, j) -= value;
-        }
-      }
+    auto a = matrix;
+    for (int i = 0; i < std::min(a.Rows(), a.Cols()); i++) {
+      a.Real().At(i, i) -= value.real();
+      a.Imag().At(i, i) -= value.imag();
     }
-    auto x = GaussSolve(a, b).first;
+    auto x = GaussSolve(a, b).first.ToComplex();
     if (std::abs(EuclideanNorm<std::complex<T>>(x)) >
           std::abs(Matrix<std::complex<T>>::GetEps())) {
       ans.push_back(x);
@@ -51,3 +51,22 @@ std::vector<Matrix<std::complex<T>>> FindEigenvectorsByValues(
   }
   return ans;
 }
+
+}
+
+template<class T>
+std::vector<Matrix<std::complex<T>>> FindEigenvectorsByValues(
+    const Matrix<std::complex<T>>& matrix,
+    const std::vector<std::complex<T>>& values) {
+  return __internal::SplitEigenvectorsByValues(SplitComplexMatrix<T>(matrix),
+                                               values);
+}
+
+// For a real matrix, which is not made complex.
+template<class T>
+std::vector<Matrix<std::complex<T>>> FindEigenvectorsByValues(
+    const Matrix<T>& matrix,
+    const std::vector<std::complex<T>>& values) {
+  return __internal::SplitEigenvectorsByValues(SplitComplexMatrix<T>(matrix),
+                                               values);
+}
@@ -1,14 +1,124 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
 #include <complex>
+#include <limits>
+#include <type_traits>
+#include "Matrix/matrix.h"
 
-template<class T, class Matrix>
-T EuclideanNorm(const Matrix& a) {
-  T res = T();
-  for (int i = 0; i < a.Rows(); i++) {
-    for (int j = 0; j < a.Cols(); j++) {
-      res += a.At(i, j) * a.At(i, j);
+namespace __internal {
+
+inline constexpr int kNormLanes = 4;
+
+template<class S>
+S AbsSquared(S x) {
+  return x * x;
+}
+
+template<class S>
+S AbsSquared(const std::complex<S>& x) {
+  return x.real() * x.real() + x.imag() * x.imag();
+}
+
+template<class S>
+S AbsMax(S x) {
+  return std::abs(x);
+}
+
+// Largest part by modulus: cheaper than std::abs and enough for scaling.
+template<class S>
+S AbsMax(const std::complex<S>& x) {
+  return std::max(std::abs(x.real()), std::abs(x.imag()));
+}
+
+// Adds sum |x_k * scale * scale2|^2 and max_k AbsMax(x_k) of count entries
+// stride apart to sum and max. kNormLanes independent accumulators keep the
+// additions pipelined, and with stride 1 the compiler turns them into
+// vector lanes.
+template<class T, class S>
+void AddSquares(const T* x, int count, int stride, S scale, S scale2,
+                S* sum, S* max) {
+  S sums[kNormLanes] = {};
+  S maxes[kNormLanes] = {};
+  int k = 0;
+  if (stride == 1) {
+    for (; k + kNormLanes <= count; k += kNormLanes) {
+      for (int lane = 0; lane < kNormLanes; lane++) {
+        sums[lane] += AbsSquared(x[k + lane] * scale * scale2);
+        maxes[lane] = std::max(maxes[lane], AbsMax(x[k + lane]));
+      }
     }
   }
-  return std::sqrt(res);
+  for (; k < count; k++) {
+    sums[0] += AbsSquared(x[size_t(k) * stride] * scale * scale2);
+    maxes[0] = std::max(maxes[0], AbsMax(x[size_t(k) * stride]));
+  }
+  for (int lane = 0; lane < kNormLanes; lane++) {
+    *sum += sums[lane];
+    *max = std::max(*max, maxes[lane]);
+  }
+}
+
+// Runs f(pointer, count, stride) over the entries of a: a column vector in
+// one call, otherwise row by row.
+template<class T, class F>
+void ForEachRun(const Matrix<T>& a, const F& f) {
+  if (a.Rows() == 0 || a.Cols() == 0) {
+    return;
+  }
+  if (a.Cols() == 1) {
+    f(&a.At(0, 0), a.Rows(), a.RowStride());
+    return;
+  }
+  for (int i = 0; i < a.Rows(); i++) {
+    f(&a.At(i, 0), a.Cols(), 1);
+  }
+}
+
+// sqrt(sum |a_ij|^2) without overflow or underflow, in one pass unless the
+// entries are so large or small that their squares are not representable.
+// Then the second pass scales them by a power of two next to the largest,
+// as LAPACK's dnrm2 does, exactly and without divisions. The power is
+// applied as two halves: for a subnormal largest entry it doesn't fit in S
+// itself.
+template<class T>
+typename ScalarOf<T>::Type FrobeniusNorm(const Matrix<T>& a) {
+  using S = typename ScalarOf<T>::Type;
+  // Below this the squares of the smaller entries lose precision. Above
+  // the sum overflows, which shows as an infinite sum.
+  static const S kSmall = std::sqrt(std::numeric_limits<S>::min() /
+                                    std::numeric_limits<S>::epsilon());
+  COUNT_WORK(uint64_t(a.Rows()) * a.Cols() * Flops<T>::kMultiplyAdd,
+             uint64_t(a.Rows()) * a.Cols() * sizeof(T));
+  S sum = 0;
+  S max = 0;
+  ForEachRun(a, [&](const T* x, int count, int stride) {
+    AddSquares(x, count, stride, S(1), S(1), &sum, &max);
+  });
+  // NaN and infinite entries make the sum NaN or infinite as they should.
+  if (std::isnan(sum) || std::isinf(max)) {
+    return sum;
+  }
+  if (max == 0 || (std::isfinite(sum) && max >= kSmall)) {
+    return std::sqrt(sum);
+  }
+  int exponent = std::ilogb(max);
+  S scale = std::ldexp(S(1), -exponent / 2);
+  S scale2 = std::ldexp(S(1), -exponent - -exponent / 2);
+  sum = 0;
+  max = 0;
+  ForEachRun(a, [&](const T* x, int count, int stride) {
+    AddSquares(x, count, stride, scale, scale2, &sum, &max);
+  });
+  return std::ldexp(std::sqrt(sum), exponent);
+}
+
+}
+
+// Euclidean (Frobenius for matrices) norm of a as a T; for complex T the
+// Hermitian sqrt(sum |a_ij|^2) with zero imaginary part.
+template<class T, class U>
+T EuclideanNorm(const Matrix<U>& a) {
+  return T(__internal::FrobeniusNorm(a));
 }
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "Matrix/matrix.h"
+#include "TimeMeasurer/scoped_profiler.h"
+#include "big_int.h"
+#include "frobenius_form.h"
+#include "mod_int.h"
+#include "polynomial.h"
+
+namespace __internal {
+
+// Primes below 2^30, largest first. Every one of them gives a separate
+// ModInt instantiation of FrobeniusForm.
+constexpr std::array<uint32_t, 48> kCrtPrimes{
+    1073741789, 1073741783, 1073741741, 1073741723, 1073741719, 1073741717,
+    1073741689, 1073741671, 1073741663, 1073741651, 1073741621, 1073741567,
+    1073741561, 1073741527, 1073741503, 1073741477, 1073741467, 1073741441,
+    1073741419, 1073741399, 1073741387, 1073741381, 1073741371, 1073741329,
+    1073741311, 1073741309, 1073741287, 1073741237, 1073741213, 1073741197,
+    1073741189, 1073741173, 1073741101, 1073741077, 1073741047, 1073740963,
+    1073740951, 1073740933, 1073740909, 1073740879, 1073740853, 1073740847,
+    1073740819, 1073740807, 1073740793, 1073740783, 1073740781, 1073740697,
+};
+
+// Coefficients of det(A - xI) modulo P, leading first. The Frobenius form is
+// exact here, so blocks are split only where the subdiagonal is zero.
+template<uint32_t P>
+std::vector<uint32_t> CharacteristicPolynomialModP(
+    const std::vector<int64_t>& a, int n) {
+  PROFILE_ZONE("CharacteristicPolynomialModP");
+  Matrix<ModInt<P>> m(n, n);
+  for (int i = 0; i < n; i++) {
+    for (int j = 0; j < n; j++) {
+      m(i, j) = a[i * n + j];
+    }
+  }
+  auto ff = FrobeniusForm(m);
+
+  Polynomial<ModInt<P>> polynomial{1};
+  int last = 0;
+  for (int i = 0; i < n; i++) {
+    if (i + 1 < n && ff(i + 1, i) != ModInt<P>()) {
+      continue;
+    }
+    Polynomial<ModInt<P>> block(i - last + 2);
+    block[0] = 1;
+    for (int j = 1; j < block.size(); j++) {
+      block[j] = -ff(last, last + j - 1);
+    }
+    polynomial = PolynomialMultiply(polynomial, block);
+    last = i + 1;
+  }
+
+  std::vector<uint32_t> ans(polynomial.size());
+  for (int i = 0; i < ans.size(); i++) {
+    ans[i] = (n % 2 == 1 ? -polynomial[i] : polynomial[i]).Value();
+  }
+  return ans;
+}
+
+using CharacteristicPolynomialModPFunction =
+    std::vector<uint32_t> (*)(const std::vector<int64_t>&, int);
+
+template<size_t... I>
+constexpr std::array<CharacteristicPolynomialModPFunction, sizeof...(I)>
+MakeCharacteristicPolynomialModPTable(std::index_sequence<I...>) {
+  return {&CharacteristicPolynomialModP<kCrtPrimes[I]>...};
+}
+
+inline uint32_t PowMod(uint64_t base, uint32_t exponent, uint32_t p) {
+  uint64_t ans = 1;
+  base %= p;
+  for (; exponent > 0; exponent >>= 1) {
+    if (exponent & 1) {
+      ans = ans * base % p;
+    }
+    base = base * base % p;
+  }
+  return ans;
+}
+
+// Mixed radix digits of the integer in [0, p_0 * ... * p_(k-1)) with the
+// given residues (Garner's algorithm).
+inline std::vector<uint32_t> MixedRadixDigits(
+    const std::vector<uint32_t>& residues,
+    const std::vector<std::vector<uint32_t>>& inverses) {
+  auto k = residues.size();
+  std::vector<uint32_t> digits(k);
+  for (int i = 0; i < k; i++) {
+    uint64_t p = kCrtPrimes[i];
+    uint64_t x = residues[i];
+    for (int j = 0; j < i; j++) {
+      x = (x + p - digits[j] % p) % p * inverses[j][i] % p;
+    }
+    digits[i] = x;
+  }
+  return digits;
+}
+
+// The integer with the given residues that is closest to zero.
+inline BigInt ReconstructSigned(
+    std::vector<uint32_t> residues,
+    const std::vector<std::vector<uint32_t>>& inverses) {
+  auto digits = MixedRadixDigits(residues, inverses);
+  // x / (p_0 * ... * p_(k-1)), only to decide the sign.
+  long double fraction = 0;
+  for (int i = 0; i < digits.size(); i++) {
+    fraction = (digits[i] + fraction) / kCrtPrimes[i];
+  }
+  bool negative = fraction > 0.5;
+  if (negative) {
+    for (int i = 0; i < residues.size(); i++) {
+      residues[i] = residues[i] == 0 ? 0 : kCrtPrimes[i] - residues[i];
+    }
+    digits = MixedRadixDigits(residues, inverses);
+  }
+  BigInt ans;
+  for (auto i = digits.size(); i-- > 0;) {
+    ans.MultiplyAdd(kCrtPrimes[i], digits[i]);
+  }
+  return negative ? -ans : ans;
+}
+
+}
+
+// Exact coefficients of det(A - xI), leading first, for a matrix with integer
+// entries. The Frobenius form is computed over ModInt for as many primes as
+// the Hadamard bound on the coefficients requires, one prime per thread, and
+// the results are joined by the Chinese remainder theorem.
+template<class T>
+std::vector<BigInt> ExactCharacteristicPolynomial(
+    const Matrix<T>& a,
+    int thread_num = std::thread::hardware_concurrency()) {
+  if (!a.IsSquare()) {
+    throw std::invalid_argument(
+        "Matrix of size " + PairToString(a.Size()) + " is not square.");
+  }
+  auto n = a.Rows();
+  std::vector<int64_t> entries(static_cast<size_t>(n) * n);
+  long double max_row_norm = 0;
+  for (int i = 0; i < n; i++) {
+    long double row_norm = 0;
+    for (int j = 0; j < n; j++) {
+      auto value = a(i, j);
+      if (value != std::round(value) || std::abs(value) > 1e18) {
+        throw std::invalid_argument("Matrix entries are not integers.");
+      }
+      entries[i * n + j] = static_cast<int64_t>(value);
+      row_norm += static_cast<long double>(value) * value;
+    }
+    max_row_norm = std::max(max_row_norm, std::sqrt(row_norm));
+  }
+
+  // The coefficient of x^(n - k) is a sum of C(n, k) principal minors, each at
+  // most norm^k by Hadamard's inequality, so it is at most (1 + norm)^n. The
+  // primes have to cover that and one more bit for the sign.
+  long double bits = n * std::log2(1 + max_row_norm) + 2;
+  int k = std::ceil(bits / std::log2(static_cast<long double>(
+      __internal::kCrtPrimes.back())));
+  k = std::max(k, 1);
+  if (k > __internal::kCrtPrimes.size()) {
+    throw std::invalid_argument(
+        "Characteristic polynomial needs " + std::to_string(k) +
+        " primes, only " + std::to_string(__internal::kCrtPrimes.size()) +
+        " are available.");
+  }
+
+  static constexpr auto table =
+      __internal::MakeCharacteristicPolynomialModPTable(
+          std::make_index_sequence<__internal::kCrtPrimes.size()>());
+  std::vector<std::vector<uint32_t>> residues(k);
+  std::atomic<int> next = 0;
+  auto thread_main = [&]() {
+    for (int i = next++; i < k; i = next++) {
+      residues[i] = table[i](entries, n);
+    }
+  };
+  thread_num = std::max(1, std::min(thread_num, k));
+  std::vector<std::thread> threads;
+  threads.reserve(thread_num);
+  for (int i = 0; i < thread_num; i++) {
+    threads.emplace_back(thread_main);
+  }
+  for (auto& thread: threads) {
+    thread.join();
+  }
+
+  PROFILE_ZONE("CRT reconstruction");
+  std::vector<std::vector<uint32_t>> inverses(k, std::vector<uint32_t>(k));
+  for (int i = 0; i < k; i++) {
+    for (int j = i + 1; j < k; j++) {
+      auto p = __internal::kCrtPrimes[j];
+      inverses[i][j] = __internal::PowMod(__internal::kCrtPrimes[i], p - 2, p);
+    }
+  }
+
+  std::vector<BigInt> ans(n + 1);
+  std::vector<uint32_t> coefficient(k);
+  for (int c = 0; c <= n; c++) {
+    for (int i = 0; i < k; i++) {
+      coefficient[i] = residues[i][c];
+    }
+    ans[c] = __internal::ReconstructSigned(coefficient, inverses);
+  }
+  return ans;
+}
@@ -1,67 +1,75 @@
 #pragma once
 
+#include <algorithm>
+#include <limits>
+#include <type_traits>
 #include "Matrix/matrix.h"
+#include "TimeMeasurer/scoped_profiler.h"
+#include "frobenius_operations.h"
 
-enum class RowOperation {
-  kSwap,
-  kAdd,
-  kMultiply,
-};
+namespace __internal {
 
+// abs() is looked up by argument so that exact element types such as ModInt
+// can take part; for them a pivot is degenerate only when it is zero.
 template<class T>
-Matrix<T> FrobeniusForm(Matrix<T> a,
-                        std::vector<std::vector<std::tuple
-                            <RowOperation, int, int, T>>>* operations = nullptr) {
-  if (!a.IsSquare()) {
-    throw std::invalid_argument(
-        "Matrix of size " + PairToString(a.Size()) + " is not square.");
-  }
-  auto n = a.Rows();
+auto PivotMagnitude(const T& x) {
+  using std::abs;
+  return abs(x);
+}
 
-  std::vector<std::tuple<RowOperation, int, int, T>> now_opers;
+template<class T>
+bool IsZeroPivot(const T& x) {
+  if constexpr (std::numeric_limits<T>::is_exact) {
+    return x == T();
+  } else {
+    return PivotMagnitude(x) < Matrix<T>::GetEps();
+  }
+}
 
+template<class T>
+void FrobeniusFormScalar(Matrix<T>& a, FrobeniusOperations<T>* operations) {
+  auto n = a.Rows();
   for (int i = n - 1; i > 0; i--) {
     int row = i;
     int col = i - 1;
     int index_of_max = 0;
 
     for (int j = 0; j < i; j++) {
-      if (std::abs(a(row, index_of_max)) < std::abs(a(row, j))) {
+      if (PivotMagnitude(a(row, index_of_max)) < PivotMagnitude(a(row, j))) {
         index_of_max = j;
       }
     }
     if (i - 1 != index_of_max) {
-      Matrix<T> r;
-      r.CopyFrom(a.Col(i - 1));
-      a.Col(i - 1).Assign(a.Col(index_of_max));
-      a.Col(index_of_max).Assign(r);
-
-      r.CopyFrom(a.Row(i - 1));
-      a.Row(i - 1).Assign(a.Row(index_of_max));
-      a.Row(index_of_max).Assign(r);
-
-      now_opers.emplace_back(RowOperation::kSwap, i - 1, index_of_max, 0);
+      a.SwapCols(i - 1, index_of_max);
+      a.SwapRows(i - 1, index_of_max);
+      if (operations) {
+        operations->Add(RowOperation::kSwap, i - 1, index_of_max, 0);
+      }
     }
 
-    if (std::abs(a(row, col)) < Matrix<T>::GetEps()) {
-      std::cerr << std::fixed << std::setprecision(30) << a(row, col) << '\n';
+    if (IsZeroPivot(a(row, col))) {
       if (operations) {
-        operations->push_back(now_opers);
-        now_opers.clear();
+        operations->EndBlock();
       }
       continue;
     }
     auto d = a(row, col);
-    now_opers.emplace_back(RowOperation::kMultiply, col, col, 1. / d);
+    if (operations) {
+      operations->Add(RowOperation::kMultiply, col, col, T(1) / d);
+    }
     a.Col(col).SubMatrix(0, 0, i + 1, -1) /= d;
     a.Row(col) *= d;
 
+    COUNT_WORK(Flops<T>::kMultiplyAdd * (n - 1) * (i + 1 + n),
+               3 * sizeof(T) * (n - 1) * (i + 1 + n));
     for (int j = 0; j < n; j++) {
       if (col == j) {
         continue;
       }
       auto d = a(row, j);
-      now_opers.emplace_back(RowOperation::kAdd, col, j, -d);
+      if (operations) {
+        operations->Add(RowOperation::kAdd, col, j, -d);
+      }
       for (int k = 0; k < i + 1; k++) {
         a(k, j) -= a(k, col) * d;
       }
@@ -70,43 +78,306 @@ Matrix<T> FrobeniusForm(Matrix<T> a,
       }
     }
   }
-  operations->push_back(now_opers);
+}
+
+// Step i of the transform is the similarity A -> (I + e_c d^T) A (I - e_c d^T)
+// with c = i - 1 and d the pivot row. The column part A -= A e_c d^T is only
+// accumulated as A_current = A + X * Y^T and applied to the matrix once per
+// block_size steps as a rank-block_size update; the row and column a step
+// reads are brought up to date just before it uses them.
+template<class T>
+void FrobeniusFormBlocked(Matrix<T>& a,
+                          FrobeniusOperations<T>* operations,
+                          int block_size) {
+  auto n = a.Rows();
+  int nb = block_size;
+  std::vector<T> x(static_cast<size_t>(n) * nb);   // n x nb
+  std::vector<T> yt(static_cast<size_t>(nb) * n);  // nb x n, Y transposed
+  std::vector<T> d(n);
+  std::vector<T> w(n);
+  std::vector<T> z(nb);
+  std::vector<char> reduced(n);  // row i is exactly e_(i - 1)
+  int k = 0;
+
+  auto flush = [&](int rows) {
+    PROFILE_ZONE("Frobenius rank-k update");
+    COUNT_WORK(Flops<T>::kMultiplyAdd * rows * k * n,
+               sizeof(T) * (2 * rows * n + k * (rows + n)));
+    const int chunk = 256;
+    for (int j0 = 0; j0 < n; j0 += chunk) {
+      int j1 = std::min(n, j0 + chunk);
+      for (int r = 0; r < rows; r++) {
+        T* ar = &a(r, 0);
+        for (int t = 0; t < k; t++) {
+          T xr = x[r * nb + t];
+          if (xr == T()) {
+            continue;
+          }
+          const T* yr = &yt[t * n];
+          for (int j = j0; j < j1; j++) {
+            ar[j] += xr * yr[j];
+          }
+        }
+      }
+    }
+    std::fill(x.begin(), x.end(), T());
+    std::fill(yt.begin(), yt.end(), T());
+    k = 0;
+  };
+
+  for (int i = n - 1; i > 0; i--) {
+    int row = i;
+    int col = i - 1;
+
+    T* ai = &a(row, 0);
+    COUNT_WORK(Flops<T>::kMultiplyAdd * k * n, sizeof(T) * k * (2 * n + 1));
+    for (int t = 0; t < k; t++) {
+      T xr = x[row * nb + t];
+      const T* yr = &yt[t * n];
+      for (int j = 0; j < n; j++) {
+        ai[j] += xr * yr[j];
+      }
+      x[row * nb + t] = T();
+    }
+
+    int index_of_max = 0;
+    for (int j = 0; j < i; j++) {
+      if (PivotMagnitude(ai[index_of_max]) < PivotMagnitude(ai[j])) {
+        index_of_max = j;
+      }
+    }
+    if (col != index_of_max) {
+      a.SwapCols(col, index_of_max);
+      a.SwapRows(col, index_of_max);
+      for (int t = 0; t < k; t++) {
+        std::swap(yt[t * n + col], yt[t * n + index_of_max]);
+        std::swap(x[col * nb + t], x[index_of_max * nb + t]);
+      }
+      if (operations) {
+        operations->Add(RowOperation::kSwap, col, index_of_max, 0);
+      }
+    }
+
+    if (IsZeroPivot(ai[col])) {
+      if (operations) {
+        operations->EndBlock();
+      }
+      continue;
+    }
+
+    COUNT_WORK(Flops<T>::kMultiplyAdd * k * (i + 1),
+               sizeof(T) * k * 3 * (i + 1));
+    for (int t = 0; t < k; t++) {
+      T yc = yt[t * n + col];
+      for (int r = 0; r <= i; r++) {
+        a(r, col) += x[r * nb + t] * yc;
+      }
+      yt[t * n + col] = T();
+    }
+
+    auto pivot = ai[col];
+    if (operations) {
+      operations->Add(RowOperation::kMultiply, col, col, T(1) / pivot);
+    }
+    COUNT_WORK(Flops<T>::kMultiply * (i + 1 + n + k),
+               2 * sizeof(T) * (i + 1 + n + k));
+    for (int r = 0; r <= i; r++) {
+      a(r, col) /= pivot;
+    }
+    T* ac = &a(col, 0);
+    for (int j = 0; j < n; j++) {
+      ac[j] *= pivot;
+    }
+    for (int t = 0; t < k; t++) {
+      x[col * nb + t] *= pivot;
+    }
+
+    for (int j = 0; j < n; j++) {
+      d[j] = j == col ? T() : ai[j];
+      if (operations && j != col) {
+        operations->Add(RowOperation::kAdd, col, j, -d[j]);
+      }
+    }
+
+    for (int r = 0; r < i; r++) {
+      x[r * nb + k] = -a(r, col);
+    }
+    for (int j = 0; j < n; j++) {
+      yt[k * n + j] = d[j];
+      ai[j] = j == col ? T(1) : T();
+    }
+    reduced[row] = true;
+    k++;
+
+    std::fill(w.begin(), w.end(), T());
+    std::fill(z.begin(), z.end(), T());
+    for (int j = 0; j < i; j++) {
+      if (j == col || d[j] == T()) {
+        continue;
+      }
+      COUNT_WORK(Flops<T>::kMultiplyAdd * (n + k),
+                 sizeof(T) * (2 * n + k));
+      const T* aj = &a(j, 0);
+      for (int l = 0; l < n; l++) {
+        w[l] += d[j] * aj[l];
+      }
+      for (int t = 0; t < k; t++) {
+        z[t] += d[j] * x[j * nb + t];
+      }
+    }
+    COUNT_WORK(Flops<T>::kMultiplyAdd * k * n, sizeof(T) * (k + 1) * n);
+    for (int t = 0; t < k; t++) {
+      const T* yr = &yt[t * n];
+      for (int l = 0; l < n; l++) {
+        w[l] += z[t] * yr[l];
+      }
+    }
+    w[col] += d[row];
+    for (int j = row + 1; j < n; j++) {
+      if (reduced[j]) {
+        w[j - 1] += d[j];
+        continue;
+      }
+      COUNT_WORK(Flops<T>::kMultiplyAdd * n, 2 * sizeof(T) * n);
+      const T* aj = &a(j, 0);
+      for (int l = 0; l < n; l++) {
+        w[l] += d[j] * aj[l];
+      }
+    }
+    COUNT_WORK(Flops<T>::kAdd * n, 3 * sizeof(T) * n);
+    for (int l = 0; l < n; l++) {
+      ac[l] += w[l];
+    }
+
+    if (k == nb) {
+      flush(i);
+    }
+  }
+  flush(n);
+}
+
+}
+
+// block_size > 1 selects the blocked transform, block_size == 1 the original
+// one column update at a time. T comes from a alone, so operations can be
+// passed as nullptr.
+template<class T>
+Matrix<T> FrobeniusForm(
+    Matrix<T> a,
+    std::type_identity_t<FrobeniusOperations<T>>* operations = nullptr,
+    int block_size = 32) {
+  PROFILE_ZONE("FrobeniusForm");
+  if (!a.IsSquare()) {
+    throw std::invalid_argument(
+        "Matrix of size " + PairToString(a.Size()) + " is not square.");
+  }
+  auto n = a.Rows();
+
+  if (operations) {
+    operations->Clear();
+    operations->Reserve(static_cast<size_t>(n + 1) * n);
+  }
+
+  if (block_size > 1) {
+    __internal::FrobeniusFormBlocked(a, operations, block_size);
+  } else {
+    __internal::FrobeniusFormScalar(a, operations);
+  }
+
+  if (operations) {
+    operations->EndBlock();
+  }
   return a;
 }
 
+// Eigenvectors for all eigenvalues of one block at once: column j of the
+// result starts as (eigenvalue_j^(size - 1), ..., eigenvalue_j, 1) on the rows
+// of the block and the block's operations are replayed in reverse on whole
+// rows, so every operation runs over a contiguous row of length k.
 template<class T>
-std::vector<Matrix<T>> EigenVectorsForFrobeniusForm(
+Matrix<T> EigenVectorsForFrobeniusBlock(
     int n,
     int shift,
     int cur_size,
-    const std::vector<std::tuple<RowOperation, int, int, T>>& operations_,
+    const FrobeniusOperations<T>& operations,
+    int block,
     const std::vector<T>& eigenvalues) {
-  std::vector<Matrix<T>> ans;
-  auto operations = operations_;
-  std::cerr << operations_.size() << '\n';
-  std::reverse(operations.begin(), operations.end());
-  for (auto eigenvalue: eigenvalues) {
-    Matrix<T> v(n, 1);
-    v(shift + cur_size - 1) = 1;
-    for (int i = shift + cur_size - 2; i >= shift; i--) {
-      v(i) = v(i + 1) * eigenvalue;
-    }
-    for (auto[operation, k1, k2, k3] : operations) {
-      switch (operation) {
-        case RowOperation::kSwap:
-          std::swap(v(k1), v(k2));
-          break;
+  PROFILE_ZONE("Frobenius eigenvectors");
+  int k = eigenvalues.size();
+  Matrix<T> v(n, k);
+  if (k == 0) {
+    return v;
+  }
+  for (int j = 0; j < k; j++) {
+    v(shift + cur_size - 1, j) = 1;
+  }
+  COUNT_WORK(__internal::Flops<T>::kMultiply * (cur_size - 1) * k,
+             2 * sizeof(T) * (cur_size - 1) * k);
+  for (int i = shift + cur_size - 2; i >= shift; i--) {
+    const T* next = &v(i + 1, 0);
+    T* cur = &v(i, 0);
+    for (int j = 0; j < k; j++) {
+      cur[j] = next[j] * eigenvalues[j];
+    }
+  }
 
-        case RowOperation::kAdd:
-          v(k1) += k3 * v(k2);
-          break;
+  auto reversed = operations.Reversed(block);
+  for (size_t i = 0; i < reversed.Size(); i++) {
+    auto k1 = reversed.First(i);
+    auto k2 = reversed.Second(i);
+    switch (reversed.Operation(i)) {
+      case RowOperation::kSwap:
+        COUNT_WORK(0, 4 * sizeof(T) * k);
+        v.SwapRows(k1, k2);
+        break;
 
-        case RowOperation::kMultiply:
-          v(k1) *= k3;
+      case RowOperation::kAdd: {
+        T value = reversed.Value(i);
+        if (value == T()) {
           break;
+        }
+        COUNT_WORK(__internal::Flops<T>::kMultiplyAdd * k,
+                   3 * sizeof(T) * k);
+        T* __restrict dst = &v(k1, 0);
+        const T* __restrict src = &v(k2, 0);
+        for (int j = 0; j < k; j++) {
+          dst[j] += value * src[j];
+        }
+        break;
+      }
+
+      case RowOperation::kMultiply: {
+        T value = reversed.Value(i);
+        COUNT_WORK(__internal::Flops<T>::kMultiply * k, 2 * sizeof(T) * k);
+        T* dst = &v(k1, 0);
+        for (int j = 0; j < k; j++) {
+          dst[j] *= value;
+        }
+        break;
       }
     }
-    ans.push_back(v);
+  }
+  return v;
+}
+
+template<class T>
+std::vector<Matrix<T>> EigenVectorsForFrobeniusForm(
+    int n,
+    int shift,
+    int cur_size,
+    const FrobeniusOperations<T>& operations,
+    int block,
+    const std::vector<T>& eigenvalues) {
+  auto v = EigenVectorsForFrobeniusBlock(
+      n, shift, cur_size, operations, block, eigenvalues);
+  std::vector<Matrix<T>> ans;
+  ans.reserve(eigenvalues.size());
+  for (int j = 0; j < v.Cols(); j++) {
+    Matrix<T> col(n, 1);
+    for (int i = 0; i < n; i++) {
+      col(i) = v(i, j);
+    }
+    ans.push_back(std::move(col));
   }
   return ans;
 }
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+enum class RowOperation : uint8_t {
+  kSwap,
+  kAdd,
+  kMultiply,
+};
+
+// Log of the elementary operations made by FrobeniusForm. Fields are kept in
+// separate arrays and blocks are separated by offsets, so the whole log is a
+// few flat buffers that can be written to a file as is.
+template<class T>
+class FrobeniusOperations {
+ public:
+  void Reserve(size_t count);
+  void Clear();
+
+  void Add(RowOperation operation, int first, int second, T value);
+  void EndBlock();
+
+  size_t Size() const;
+  int BlockCount() const;
+  size_t BlockBegin(int block) const;
+  size_t BlockEnd(int block) const;
+
+  RowOperation Operation(size_t i) const;
+  int First(size_t i) const;
+  int Second(size_t i) const;
+  T Value(size_t i) const;
+
+  class ReversedBlock;
+  ReversedBlock Reversed(int block) const;
+
+  void Write(std::ostream& out) const;
+  static FrobeniusOperations<T> Read(std::istream& in);
+
+ private:
+  std::vector<RowOperation> operations_;
+  std::vector<int32_t> first_;
+  std::vector<int32_t> second_;
+  std::vector<T> values_;
+  std::vector<uint64_t> block_ends_;
+};
+
+template<class T>
+void FrobeniusOperations<T>::Reserve(size_t count) {
+  operations_.reserve(count);
+  first_.reserve(count);
+  second_.reserve(count);
+  values_.reserve(count);
+}
+
+template<class T>
+void FrobeniusOperations<T>::Clear() {
+  operations_.clear();
+  first_.clear();
+  second_.clear();
+  values_.clear();
+  block_ends_.clear();
+}
+
+template<class T>
+void FrobeniusOperations<T>::Add(RowOperation operation,
+                                 int first,
+                                 int second,
+                                 T value) {
+  operations_.push_back(operation);
+  first_.push_back(first);
+  second_.push_back(second);
+  values_.push_back(value);
+}
+
+template<class T>
+void FrobeniusOperations<T>::EndBlock() {
+  block_ends_.push_back(operations_.size());
+}
+
+template<class T>
+size_t FrobeniusOperations<T>::Size() const {
+  return operations_.size();
+}
+
+template<class T>
+int FrobeniusOperations<T>::BlockCount() const {
+  return block_ends_.size();
+}
+
+template<class T>
+size_t FrobeniusOperations<T>::BlockBegin(int block) const {
+  return block == 0 ? 0 : block_ends_.at(block - 1);
+}
+
+template<class T>
+size_t FrobeniusOperations<T>::BlockEnd(int block) const {
+  return block_ends_.at(block);
+}
+
+template<class T>
+RowOperation FrobeniusOperations<T>::Operation(size_t i) const {
+  return operations_[i];
+}
+
+template<class T>
+int FrobeniusOperations<T>::First(size_t i) const {
+  return first_[i];
+}
+
+template<class T>
+int FrobeniusOperations<T>::Second(size_t i) const {
+  return second_[i];
+}
+
+template<class T>
+T FrobeniusOperations<T>::Value(size_t i) const {
+  return values_[i];
+}
+
+// Operations of one block from the last to the first. Only keeps indices into
+// the log, nothing is copied.
+template<class T>
+class FrobeniusOperations<T>::ReversedBlock {
+ public:
+  ReversedBlock(const FrobeniusOperations<T>& operations,
+                size_t begin,
+                size_t end)
+      : operations_(operations), begin_(begin), end_(end) {}
+
+  size_t Size() const {
+    return end_ - begin_;
+  }
+
+  RowOperation Operation(size_t i) const {
+    return operations_.Operation(end_ - 1 - i);
+  }
+  int First(size_t i) const {
+    return operations_.First(end_ - 1 - i);
+  }
+  int Second(size_t i) const {
+    return operations_.Second(end_ - 1 - i);
+  }
+  T Value(size_t i) const {
+    return operations_.Value(end_ - 1 - i);
+  }
+
+ private:
+  const FrobeniusOperations<T>& operations_;
+  size_t begin_;
+  size_t end_;
+};
+
+template<class T>
+typename FrobeniusOperations<T>::ReversedBlock
+FrobeniusOperations<T>::Reversed(int block) const {
+  return ReversedBlock(*this, BlockBegin(block), BlockEnd(block));
+}
+
+namespace __internal {
+
+template<class U>
+void WriteArray(std::ostream& out, const std::vector<U>& v) {
+  out.write(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(U));
+}
+
+template<class U>
+void ReadArray(std::istream& in, std::vector<U>& v, uint64_t size) {
+  v.resize(size);
+  in.read(reinterpret_cast<char*>(v.data()), size * sizeof(U));
+}
+
+}
+
+// Layout: operation count, block count, then the block ends and the four
+// field arrays one after another in native byte order.
+template<class T>
+void FrobeniusOperations<T>::Write(std::ostream& out) const {
+  uint64_t header[2]{operations_.size(), block_ends_.size()};
+  out.write(reinterpret_cast<const char*>(header), sizeof(header));
+  __internal::WriteArray(out, block_ends_);
+  __internal::WriteArray(out, operations_);
+  __internal::WriteArray(out, first_);
+  __internal::WriteArray(out, second_);
+  __internal::WriteArray(out, values_);
+}
+
+template<class T>
+FrobeniusOperations<T> FrobeniusOperations<T>::Read(std::istream& in) {
+  uint64_t header[2];
+  in.read(reinterpret_cast<char*>(header), sizeof(header));
+  FrobeniusOperations<T> ans;
+  __internal::ReadArray(in, ans.block_ends_, header[1]);
+  __internal::ReadArray(in, ans.operations_, header[0]);
+  __internal::ReadArray(in, ans.first_, header[0]);
+  __internal::ReadArray(in, ans.second_, header[0]);
+  __internal::ReadArray(in, ans.values_, header[0]);
+  if (!in) {
+    throw std::runtime_error("Truncated Frobenius operations log");
+  }
+  return ans;
+}
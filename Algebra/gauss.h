@@ -2,6 +2,7 @@
 
 #include "gauss_back_substitution.h"
 #include <complex>
+#include "Matrix/split_complex.h"
 
 template<class Matrix>
 std::pair<Matrix, int> GaussSolve(Matrix a, Matrix b) {
@@ -54,3 +55,86 @@ std::pair<Matrix, int> GaussSolve(Matrix a, Matrix b) {
   }
   return {SolveUxb(swapped_a, swapped_b), rank};
 }
+
+// GaussSolve for a complex system in split planes, with the pivots, the
+// thresholds and the results of GaussSolve on Matrix<std::complex<T>>. The
+// row updates, all but O(n^2) of the work, are real loops over both planes.
+template<class T>
+std::pair<SplitComplexMatrix<T>, int> GaussSolve(SplitComplexMatrix<T> a,
+                                                 SplitComplexMatrix<T> b) {
+  if (!a.IsSquare()) {
+    throw std::invalid_argument(
+        "Matrix of size " + PairToString(a.Size()) + " is not square.");
+  }
+  if (!b.IsColVector()) {
+    throw std::invalid_argument(
+        "Matrix of size " + PairToString(b.Size()) + " is not col.");
+  }
+  if (b.Rows() != a.Rows()) {
+    throw std::invalid_argument(
+        "Bad matrix sizes: " + PairToString(a.Size()) + " and "
+            + PairToString(b.Size()));
+  }
+  auto n = a.Rows();
+  T eps = std::abs(Matrix<std::complex<T>>::GetEps());
+  std::vector<size_t> reindex(n);
+  std::iota(reindex.begin(), reindex.end(), 0);
+
+  for (int i = 0; i < n; i++) {
+    size_t index_of_max = i;
+    for (int k = i + 1; k < n; k++) {
+      if (std::abs(a.At(reindex[index_of_max], i))
+          < std::abs(a.At(reindex[k], i))) {
+        index_of_max = k;
+      }
+    }
+    std::swap(reindex[i], reindex[index_of_max]);
+    auto pivot = a.At(reindex[i], i);
+    if (std::abs(pivot) < eps) {
+      continue;
+    }
+    const T* pivot_re = &a.Real().At(reindex[i], i);
+    const T* pivot_im = &a.Imag().At(reindex[i], i);
+    for (int j = i + 1; j < n; j++) {
+      if (std::abs(a.At(reindex[j], i)) < eps) {
+        continue;
+      }
+      auto m = a.At(reindex[j], i) / pivot;
+      T m_re = m.real();
+      T m_im = m.imag();
+      T* re = &a.Real().At(reindex[j], i);
+      T* im = &a.Imag().At(reindex[j], i);
+      for (int k = 0; k < n - i; k++) {
+        re[k] -= m_re * pivot_re[k] - m_im * pivot_im[k];
+        im[k] -= m_re * pivot_im[k] + m_im * pivot_re[k];
+      }
+      auto rhs = b.At(reindex[j], 0) - m * b.At(reindex[i], 0);
+      b.Real().At(reindex[j], 0) = rhs.real();
+      b.Imag().At(reindex[j], 0) = rhs.imag();
+      COUNT_WORK(__internal::Flops<std::complex<T>>::kMultiplyAdd * (n - i),
+                 4 * sizeof(T) * (n - i));
+    }
+  }
+
+  // SolveUxb on the rows in pivot order.
+  SplitComplexMatrix<T> x(n, 1);
+  int rank = 0;
+  for (int i = n - 1; i >= 0; i--) {
+    auto row = reindex[i];
+    auto sum = b.At(row, 0);
+    for (int j = n - 1; j > i; j--) {
+      sum -= x.At(j, 0) * a.At(row, j);
+    }
+    auto diagonal = a.At(row, i);
+    std::complex<T> value = 1;
+    if (std::abs(diagonal) >= 5 * eps) {
+      value = sum / diagonal;
+    }
+    x.Real().At(i, 0) = value.real();
+    x.Imag().At(i, 0) = value.imag();
+    if (std::abs(diagonal) > eps) {
+      rank++;
+    }
+  }
+  return {x, rank};
+}
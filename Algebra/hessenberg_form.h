@@ -1,10 +1,12 @@
 #pragma once
 
 #include "Matrix/matrix.h"
+#include "TimeMeasurer/scoped_profiler.h"
 #include "euclidean_norm.h"
 
 template<class T>
 Matrix<T> ReflectionsHessenberg(Matrix<T> a) {
+  PROFILE_ZONE("ReflectionsHessenberg");
   if (!a.IsSquare()) {
     throw std::invalid_argument(
         "Matrix of size " + PairToString(a.Size()) + " is not square.");
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+
+// Residue modulo a prime P < 2^31, usable as the element type of Matrix.
+// abs() returns the canonical residue, so pivot searches written for real
+// matrices pick some nonzero element and every zero test is exact.
+template<uint32_t P>
+class ModInt {
+ public:
+  ModInt() = default;
+  ModInt(int64_t value);
+
+  uint32_t Value() const;
+  ModInt<P> Inverse() const;
+
+  ModInt<P>& operator+=(ModInt<P> b);
+  ModInt<P>& operator-=(ModInt<P> b);
+  ModInt<P>& operator*=(ModInt<P> b);
+  ModInt<P>& operator/=(ModInt<P> b);
+
+  ModInt<P> operator-() const;
+
+  friend ModInt<P> operator+(ModInt<P> a, ModInt<P> b) {
+    return a += b;
+  }
+  friend ModInt<P> operator-(ModInt<P> a, ModInt<P> b) {
+    return a -= b;
+  }
+  friend ModInt<P> operator*(ModInt<P> a, ModInt<P> b) {
+    return a *= b;
+  }
+  friend ModInt<P> operator/(ModInt<P> a, ModInt<P> b) {
+    return a /= b;
+  }
+  friend bool operator==(ModInt<P> a, ModInt<P> b) {
+    return a.value_ == b.value_;
+  }
+  friend bool operator!=(ModInt<P> a, ModInt<P> b) {
+    return a.value_ != b.value_;
+  }
+  friend uint32_t abs(ModInt<P> a) {
+    return a.value_;
+  }
+  friend std::ostream& operator<<(std::ostream& out, ModInt<P> a) {
+    return out << a.value_;
+  }
+
+ private:
+  static_assert(P > 1 && P < (1u << 31));
+
+  uint32_t value_ = 0;
+};
+
+template<uint32_t P>
+ModInt<P>::ModInt(int64_t value) {
+  value %= static_cast<int64_t>(P);
+  if (value < 0) {
+    value += P;
+  }
+  value_ = value;
+}
+
+template<uint32_t P>
+uint32_t ModInt<P>::Value() const {
+  return value_;
+}
+
+template<uint32_t P>
+ModInt<P> ModInt<P>::Inverse() const {
+  if (value_ == 0) {
+    throw std::invalid_argument("Zero has no inverse");
+  }
+  ModInt<P> ans = 1;
+  ModInt<P> base = *this;
+  for (uint32_t e = P - 2; e > 0; e >>= 1) {
+    if (e & 1) {
+      ans *= base;
+    }
+    base *= base;
+  }
+  return ans;
+}
+
+template<uint32_t P>
+ModInt<P>& ModInt<P>::operator+=(ModInt<P> b) {
+  value_ += b.value_;
+  if (value_ >= P) {
+    value_ -= P;
+  }
+  return *this;
+}
+
+template<uint32_t P>
+ModInt<P>& ModInt<P>::operator-=(ModInt<P> b) {
+  value_ += P - b.value_;
+  if (value_ >= P) {
+    value_ -= P;
+  }
+  return *this;
+}
+
+template<uint32_t P>
+ModInt<P>& ModInt<P>::operator*=(ModInt<P> b) {
+  value_ = static_cast<uint64_t>(value_) * b.value_ % P;
+  return *this;
+}
+
+template<uint32_t P>
+ModInt<P>& ModInt<P>::operator/=(ModInt<P> b) {
+  return *this *= b.Inverse();
+}
+
+template<uint32_t P>
+ModInt<P> ModInt<P>::operator-() const {
+  return ModInt<P>() - *this;
+}
+
+namespace std {
+
+template<uint32_t P>
+class numeric_limits<ModInt<P>> {
+ public:
+  static constexpr bool is_specialized = true;
+  static constexpr bool is_exact = true;
+  static constexpr bool is_signed = false;
+  static constexpr bool is_integer = false;
+
+  static ModInt<P> epsilon() {
+    return ModInt<P>();
+  }
+};
+
+}
@@ -1,6 +1,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <vector>
 #include <optional>
 #include "Algebra/polynomial.h"
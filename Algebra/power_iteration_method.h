@@ -1,42 +1,87 @@
 #pragma once
 
+#include <iostream>
 #include "Matrix/matrix.h"
+#include "TimeMeasurer/scoped_profiler.h"
+#include "convergence_trace.h"
 #include "euclidean_norm.h"
-#include "minimal_square_problem.h"
 #include "eigenvalues.h"
+#include "subspace_iteration.h"
+
+enum class PowerAcceleration {
+  kNone,
+  kAitken,     // Aitken delta^2 extrapolation of the eigenvalue estimates
+  kWynn,       // Wynn epsilon algorithm on the last five estimates
+  kChebyshev,  // Chebyshev filtering of the iterates, method 1 only
+};
 
 namespace __internal {
 
+// Vectors of the power method for a complex conjugate pair, kept from one
+// iteration to the next: u and its products a u and a^2 u.
 template<class T>
-std::pair<std::complex<T>, std::complex<T>>
-PowerMethodEigenvaluesComplexIteration(
-    const Matrix<std::complex<T>>& a,
-    Matrix<std::complex<T>>& y,
-    Matrix<std::complex<T>>& u) {
-  y.Assign(a * u);
-  u.Assign(y / EuclideanNorm<std::complex<T>>(y));
+struct PairIterationWorkspace {
+  explicit PairIterationWorkspace(int n) : u(n, 1), au(n, 1), aau(n, 1) {}
 
-  Matrix<T> l(u.Rows(), 2);
-  auto au = a * u;
-  for (int i = 0; i < u.Rows(); i++) {
-    l(i, 0) = u(i).real();
-    l(i, 1) = au(i).real();
+  // Starts from u = y / |y|.
+  void Start(const Matrix<T>& a, const Matrix<T>& y) {
+    u.Assign(y / EuclideanNorm<T>(y));
+    MultiplyInto(a, u, au);
+    MultiplyInto(a, au, aau);
   }
-  auto rc = -1 * a * (a * u);
-  Matrix<T> r(u.Rows(), 1);
-  for (int i = 0; i < u.Rows(); i++) {
-    r(i) = rc(i).real();
+
+  // u = a u / |a u|, which leaves a single product to compute.
+  void Step(const Matrix<T>& a) {
+    T norm = EuclideanNorm<T>(au);
+    for (int i = 0; i < u.Rows(); i++) {
+      u(i) = au(i) / norm;
+      au(i) = aau(i) / norm;
+    }
+    MultiplyInto(a, au, aau);
   }
-  auto c = MinimalSquareProblem(l, r);
-  auto[r1, r2] =
-    SolveQuadraticEquation<T>(1, c(1), c(0));
 
-  return {r1, r2};
-}
+  Matrix<T> u;
+  Matrix<T> au;
+  Matrix<T> aau;
+};
 
+// Steps u and returns the roots of lambda^2 + c1 lambda + c0, where c
+// minimises |c0 u + c1 a u + a^2 u|. The two column least squares problem
+// is solved on u and the part of a u orthogonal to it, from their dot
+// products with each other and a^2 u.
 template<class T>
+std::pair<std::complex<T>, std::complex<T>>
+PowerMethodEigenvaluesComplexIteration(const Matrix<T>& a,
+                                       PairIterationWorkspace<T>& w) {
+  w.Step(a);
+  int n = a.Rows();
+  T uu = 0;
+  T uau = 0;
+  T uaau = 0;
+  for (int i = 0; i < n; i++) {
+    uu += w.u(i) * w.u(i);
+    uau += w.u(i) * w.au(i);
+    uaau += w.u(i) * w.aau(i);
+  }
+  T beta = uau / uu;
+  T pp = 0;
+  T paau = 0;
+  for (int i = 0; i < n; i++) {
+    T p = w.au(i) - beta * w.u(i);
+    pp += p * p;
+    paau += p * w.aau(i);
+  }
+  // a u along u: SolveUxb takes 1 for the unknown of a zero pivot, and so
+  // does this.
+  T c1 = std::sqrt(pp) >= 5 * Matrix<T>::GetEps() ? -paau / pp : 1;
+  T c0 = -uaau / uu - c1 * beta;
+  COUNT_WORK(11 * uint64_t(n), 5 * sizeof(T) * uint64_t(n));
+  return SolveQuadraticEquation<T>(1, c1, c0);
+}
+
+template<class T, class Operator>
 T PowerIterationMethod1Iteration(
-    const Matrix<T>& a,
+    const Operator& a,
     Matrix<T>& u,
     Matrix<T>& y) {
   y.Assign(a * u);
@@ -49,7 +94,8 @@ template<class T>
 std::pair<bool, Matrix<T>> PowerIterationMethod1IterationConverges(
     const Matrix<T>& a,
     int iters,
-    int step) {
+    int step,
+    ConvergenceTrace* trace = nullptr) {
   int n = a.Rows();
   auto y = Matrix<T>(n, 1);
   y(0) = 1;
@@ -62,6 +108,10 @@ std::pair<bool, Matrix<T>> PowerIterationMethod1IterationConverges(
     prev_lambda = lambda;
     lambda = __internal::PowerIterationMethod1Iteration(a, u, y);
     diffs.push_back(std::abs(prev_lambda - lambda));
+    if (trace) {
+      trace->Record(TraceSolver::kPowerMethod1, TraceEvent::kResidual, i, 0,
+                    static_cast<double>(diffs.back()));
+    }
     if (std::abs(diffs.back()) < Matrix<T>::GetEps()) {
       return {true, y};
     }
@@ -95,51 +145,209 @@ bool DoSequenceConverge(const std::vector<T>& v, T eps) {
   return false;
 }
 
+// Estimates the limit of a sequence of eigenvalue estimates from its last
+// terms. For a sequence converging as c q^k Aitken's delta^2 is exact; the
+// epsilon algorithm of Wynn is exact for a sum of two such terms, which is
+// what a second eigenvalue close to the first one gives.
 template<class T>
-std::pair<bool, Matrix<T>> PowerIterationMethod2IterationConverges(
-    const Matrix<T>& a,
-    int iters,
-    T converge_eps) {
-  int n = a.Rows();
-  auto y = Matrix<T>(n, 1);
-  y(0) = 1;
-  auto u = y / EuclideanNorm<T>(y);
-  auto lambda = u.ScalarProduct(a * u);
-  for (int i = 0; i < iters; i++) {
-    lambda = __internal::PowerIterationMethod2Iteration(a, u, y);
+class SequenceExtrapolator {
+ public:
+  explicit SequenceExtrapolator(PowerAcceleration acceleration)
+      : acceleration_(acceleration) {}
+
+  // Adds the next term and returns the current estimate of the limit.
+  T Add(T value) {
+    if (terms_.size() == kTerms) {
+      terms_.erase(terms_.begin());
+    }
+    terms_.push_back(value);
+    switch (acceleration_) {
+      case PowerAcceleration::kAitken:
+        return Aitken();
+      case PowerAcceleration::kWynn:
+        return Wynn();
+      default:
+        return value;
+    }
   }
-  lambda = std::sqrt(std::abs(lambda));
-  auto v1 = (lambda * a * u + a * (a * u)) / (2 * lambda * lambda);
-  auto v2 = (-lambda * a * u + a * (a * u)) / (2 * lambda * lambda);
-  if ((EuclideanNorm<T>(a * v1 - lambda * v1) < converge_eps &&
-  EuclideanNorm<T>(v1) > Matrix<T>::GetEps()) ||
-      (EuclideanNorm<T>(a * v2 + lambda * v2) < converge_eps &&
-      EuclideanNorm<T>(v2) > Matrix<T>::GetEps())) {
-    return {true, y};
+
+ private:
+  static constexpr int kTerms = 5;
+
+  T Aitken() const {
+    int m = terms_.size();
+    if (m < 3) {
+      return terms_.back();
+    }
+    T delta = terms_[m - 1] - terms_[m - 2];
+    T delta2 = delta - (terms_[m - 2] - terms_[m - 3]);
+    T ans = terms_[m - 1] - delta * delta / delta2;
+    return delta2 != 0 && std::isfinite(ans) ? ans : terms_.back();
   }
-  return {false, y};
-}
 
+  // Columns eps_{k + 1}(i) = eps_{k - 1}(i + 1) + 1 / (eps_k(i + 1) -
+  // eps_k(i)), the last entry of the highest even column is the estimate.
+  T Wynn() const {
+    int m = terms_.size();
+    std::vector<T> prev(m + 1, 0);
+    std::vector<T> cur(terms_.begin(), terms_.end());
+    T ans = terms_.back();
+    for (int k = 1; k < m; k++) {
+      std::vector<T> next(m - k);
+      for (int i = 0; i < m - k; i++) {
+        T diff = cur[i + 1] - cur[i];
+        if (diff == 0) {
+          return ans;
+        }
+        next[i] = prev[i + 1] + 1 / diff;
+      }
+      if (k % 2 == 0 && std::isfinite(next.back())) {
+        ans = next.back();
+      }
+      prev = std::move(cur);
+      cur = std::move(next);
+    }
+    return ans;
+  }
+
+  PowerAcceleration acceleration_;
+  std::vector<T> terms_;
+};
+
+// Chebyshev filtering for the power method. Once plain steps show a steady
+// ratio q by which the estimate changes shrink, the other eigenvalues are
+// taken to lie in [-e, e] with e = |lambda| sqrt(q). For symmetric matrices,
+// whose Rayleigh quotients converge as (lambda_2 / lambda_1)^2, that is
+// |lambda_2|. Every later step applies the degree kDegree Chebyshev
+// polynomial of the interval, which grows lambda_1 against it as
+// T_k(lambda_1 / e) instead of (lambda_1 / e)^k. On a real spectrum any
+// e below |lambda_1| still favours lambda_1, only less so. Complex
+// eigenvalues off the interval can make filtering slower than plain steps,
+// so it switches itself off once a filtered step changes the estimate more
+// than the one before.
 template<class T>
+class ChebyshevFilter {
+ public:
+  static constexpr int kDegree = 8;
+
+  explicit ChebyshevFilter(bool enabled) : enabled_(enabled) {}
+
+  bool Active() const {
+    return enabled_ && half_width_ > 0;
+  }
+
+  // Takes the change of the estimate after a step.
+  void Observe(T change, T lambda, bool filtered) {
+    if (!enabled_) {
+      return;
+    }
+    if (filtered) {
+      enabled_ = change < last_filtered_change_;
+      last_filtered_change_ = change;
+      return;
+    }
+    changes_.push_back(change);
+    int m = changes_.size();
+    if (half_width_ > 0 || m < kStableRatios + 1 ||
+        change > kSettled * std::abs(lambda)) {
+      return;
+    }
+    // Early steps still carry the start vector; the ratio is trusted once
+    // the last few agree.
+    T q = changes_[m - 1] / changes_[m - 2];
+    for (int k = 1; k < kStableRatios; k++) {
+      T other = changes_[m - 1 - k] / changes_[m - 2 - k];
+      if (!(std::abs(other - q) <= kRatioTolerance * q)) {
+        return;
+      }
+    }
+    if (q > 0 && q < 1) {
+      half_width_ = std::abs(lambda) * std::sqrt(q);
+    }
+  }
+
+  // kDegree steps of the three-term recurrence scaled so that the iterates
+  // stay of unit size, then u = p(A) u / |p(A) u|. Returns the Rayleigh
+  // quotient.
+  template<class Operator>
+  T Apply(const Operator& a, Matrix<T>& u, Matrix<T>& y, T lambda) const {
+    T e = half_width_;
+    T sigma1 = e / lambda;
+    T sigma = sigma1;
+    auto prev = u;
+    y.Assign(a * u * (sigma1 / e));
+    for (int k = 2; k <= kDegree; k++) {
+      T sigma2 = 1 / (2 / sigma1 - sigma);
+      auto next = a * y * (2 * sigma2 / e) - prev * (sigma * sigma2);
+      prev.Assign(y);
+      y.Assign(next);
+      sigma = sigma2;
+    }
+    u.Assign(y / EuclideanNorm<T>(y));
+    return u.ScalarProduct(a * u);
+  }
+
+ private:
+  static constexpr int kStableRatios = 3;
+  static constexpr T kRatioTolerance = 0.02;
+  // Relative change below which the estimate is close enough to lambda_1
+  // for the interval to be taken from it.
+  static constexpr T kSettled = 0.01;
+
+  bool enabled_;
+  T half_width_ = 0;
+  T last_filtered_change_ = std::numeric_limits<T>::infinity();
+  std::vector<T> changes_;
+};
+
+// Starts from y. Convergence is judged on the Rayleigh quotients of the
+// iterates themselves, which is when the vector has settled too; with an
+// extrapolation the returned eigenvalue is the extrapolated one, closer to
+// the limit than the last quotient. A Chebyshev step counts as kDegree
+// iterations. Besides a Matrix, a can be any operator with Rows(),
+// Size(), IsSquare() and a product a * u by a column.
+template<class T, class Operator>
 std::pair<T, Matrix<T>> PowerMethodEigenvalues1(
-    const Matrix<T>& a,
+    const Operator& a,
     Matrix<T> y,
     int* iters = nullptr,
-    int max_iters = 100) {
+    int max_iters = 100,
+    ConvergenceTrace* trace = nullptr,
+    PowerAcceleration acceleration = PowerAcceleration::kNone) {
+  PROFILE_ZONE("Power method 1");
   if (!a.IsSquare()) {
     throw std::invalid_argument(
         "Matrix of size " + PairToString(a.Size()) + " is not square.");
   }
-  int n = a.Rows();
-  y(0) = 1;
   auto u = y / EuclideanNorm<T>(y);
   auto lambda = u.ScalarProduct(a * u);
+  SequenceExtrapolator<T> extrapolator(acceleration);
+  ChebyshevFilter<T> filter(acceleration == PowerAcceleration::kChebyshev);
+  auto estimate = extrapolator.Add(lambda);
   int iter = 0;
-  auto prev_lambda = 1e18;
+  T prev_lambda = 1e18;
   while (std::abs(prev_lambda - lambda) > Matrix<T>::GetEps()) {
     prev_lambda = lambda;
-    lambda = __internal::PowerIterationMethod1Iteration(a, u, y);
-    iter++;
+    bool filtered = filter.Active();
+    if (filtered) {
+      lambda = filter.Apply(a, u, y, lambda);
+      iter += ChebyshevFilter<T>::kDegree;
+    } else {
+      lambda = __internal::PowerIterationMethod1Iteration(a, u, y);
+      iter++;
+    }
+    filter.Observe(std::abs(prev_lambda - lambda), lambda, filtered);
+    estimate = extrapolator.Add(lambda);
+    if (trace) {
+      trace->Record(TraceSolver::kPowerMethod1, TraceEvent::kEigenvalue, iter,
+                    0, static_cast<double>(lambda));
+      if (acceleration != PowerAcceleration::kNone) {
+        trace->Record(TraceSolver::kPowerMethod1, TraceEvent::kEigenvalue,
+                      iter, 1, static_cast<double>(estimate));
+      }
+      trace->Record(TraceSolver::kPowerMethod1, TraceEvent::kResidual, iter,
+                    0, static_cast<double>(std::abs(prev_lambda - lambda)));
+    }
     if (iter > max_iters) {
       break;
     }
@@ -150,9 +358,12 @@ std::pair<T, Matrix<T>> PowerMethodEigenvalues1(
       *iters = -1;
     }
   }
-  return {lambda, u};
+  return {estimate, u};
 }
 
+// Extrapolates the estimates of |lambda| like PowerMethodEigenvalues1,
+// with convergence judged on the raw ones; Chebyshev filtering is not
+// applied here.
 template<class T>
 std::vector<std::pair<std::complex<T>,
                       Matrix<std::complex<T>>>> PowerMethodEigenvalues2(
@@ -160,23 +371,39 @@ std::vector<std::pair<std::complex<T>,
     Matrix<T>& y,
     int* iters = nullptr,
     int max_iters = 100,
-    T eps = Matrix<T>::GetEps()) {
+    T eps = Matrix<T>::GetEps(),
+    ConvergenceTrace* trace = nullptr,
+    PowerAcceleration acceleration = PowerAcceleration::kNone) {
+  PROFILE_ZONE("Power method 2");
   if (!a.IsSquare()) {
     throw std::invalid_argument(
         "Matrix of size " + PairToString(a.Size()) + " is not square.");
   }
   int n = a.Rows();
   auto u = y / EuclideanNorm<T>(y);
-  auto lambda = std::sqrt(std::abs(u.ScalarProduct(a * (a * u))));
+  SequenceExtrapolator<T> extrapolator(acceleration);
+  T raw = std::sqrt(std::abs(u.ScalarProduct(a * (a * u))));
+  auto lambda = extrapolator.Add(raw);
   auto v1 = u;
   auto v2 = u;
   int iter = 0;
-  auto prev_lambda = 1e18;
-  while (std::abs(lambda - prev_lambda) > eps) {
-    prev_lambda = lambda;
-    lambda = std::sqrt(std::abs(
+  T prev_raw = 1e18;
+  while (std::abs(raw - prev_raw) > eps) {
+    prev_raw = raw;
+    raw = std::sqrt(std::abs(
         __internal::PowerIterationMethod2Iteration(a, u, y)));
+    lambda = extrapolator.Add(raw);
     iter++;
+    if (trace) {
+      trace->Record(TraceSolver::kPowerMethod2, TraceEvent::kEigenvalue, iter,
+                    0, static_cast<double>(raw));
+      if (acceleration != PowerAcceleration::kNone) {
+        trace->Record(TraceSolver::kPowerMethod2, TraceEvent::kEigenvalue,
+                      iter, 1, static_cast<double>(lambda));
+      }
+      trace->Record(TraceSolver::kPowerMethod2, TraceEvent::kResidual, iter,
+                    0, static_cast<double>(std::abs(raw - prev_raw)));
+    }
     if (iter > max_iters) {
       break;
     }
@@ -208,18 +435,21 @@ std::vector<std::pair<std::complex<T>,
     const Matrix<T>& a,
     int* iters = nullptr,
     int max_iters = 100,
-    bool optimize = false) {
+    bool optimize = false,
+    ConvergenceTrace* trace = nullptr) {
+  PROFILE_ZONE("Power method 3");
   if (!a.IsSquare()) {
     throw std::invalid_argument(
         "Matrix of size " + PairToString(a.Size()) + " is not square.");
   }
   int n = a.Rows();
 
-  auto complex_a = a.ToComplex();
-
-  Matrix<std::complex<T>> complex_y(n, 1);
-  complex_y(0) = 1;
-  auto u = complex_y / EuclideanNorm<std::complex<T>>(complex_y);
+  // The products of a real a and a real start stay real, so the iteration
+  // runs in T and only the vectors at the end are complex.
+  __internal::PairIterationWorkspace<T> w(n);
+  Matrix<T> y(n, 1);
+  y(0) = 1;
+  w.Start(a, y);
 
   std::complex<T> prev_r1 = 1e18;
   std::complex<T> r1;
@@ -229,14 +459,12 @@ std::vector<std::pair<std::complex<T>,
   int iter = 0;
 
   if (optimize) {
+    // Plain power steps first, the roots only from the last one.
     for (int i = 0; i < std::min(max_iters - 5, 2 * n); i++) {
-      complex_y.Assign(complex_a * u);
+      w.Step(a);
       iter++;
     }
-    u.Assign(complex_y / EuclideanNorm<std::complex<T>>(complex_y));
-    auto[p1, p2] =
-    __internal::PowerMethodEigenvaluesComplexIteration(
-        complex_a, complex_y, u);
+    auto[p1, p2] = __internal::PowerMethodEigenvaluesComplexIteration(a, w);
     prev_r1 = p1;
     prev_r2 = p2;
     r1 = p1;
@@ -246,29 +474,33 @@ std::vector<std::pair<std::complex<T>,
 
   while (std::abs(prev_r1 - r1) > std::abs(Matrix<T>::GetEps()) ||
       std::abs(prev_r2 - r2) > std::abs(Matrix<T>::GetEps())) {
-    auto[p1, p2] =
-    __internal::PowerMethodEigenvaluesComplexIteration(
-        complex_a, complex_y, u);
+    auto[p1, p2] = __internal::PowerMethodEigenvaluesComplexIteration(a, w);
     prev_r1 = r1;
     prev_r2 = r2;
     r1 = p1;
     r2 = p2;
 
     iter++;
+    if (trace) {
+      trace->Record(TraceSolver::kPowerMethod3, TraceEvent::kEigenvalue, iter,
+                    0, std::complex<double>(r1));
+      trace->Record(TraceSolver::kPowerMethod3, TraceEvent::kEigenvalue, iter,
+                    1, std::complex<double>(r2));
+      trace->Record(TraceSolver::kPowerMethod3, TraceEvent::kResidual, iter,
+                    0, static_cast<double>(std::max(std::abs(prev_r1 - r1),
+                                                    std::abs(prev_r2 - r2))));
+    }
     if (iter > max_iters) {
       break;
     }
   }
 
-  auto u1 = complex_a * u;
-  auto u2 = complex_a * (complex_a * u);
-
-  Matrix<std::complex<T>> v1(u.Rows(), 1);
-  Matrix<std::complex<T>> v2(u.Rows(), 1);
+  Matrix<std::complex<T>> v1(n, 1);
+  Matrix<std::complex<T>> v2(n, 1);
 
-  for (int i = 0; i < u.Rows(); i++) {
-    v1(i) = u2(i) - r2 * u1(i);
-    v2(i) = u1(i) - u2(i) / r1;
+  for (int i = 0; i < n; i++) {
+    v1(i) = w.aau(i) - r2 * w.au(i);
+    v2(i) = w.au(i) - w.aau(i) / r1;
   }
 
   if (iters) {
@@ -295,56 +527,47 @@ std::vector<std::pair<std::complex<T>,
 
 }
 
+// force_method 0, 1 and 2 run the power method for a single dominant
+// eigenvalue, for a pair +-lambda and for a complex conjugate pair, with
+// acceleration applied to the first two. By default the dominant
+// eigenvalues are found by SubspaceIteration, which handles all three cases
+// alike; check_iters and converge_eps tuned the probe that used to choose
+// between the methods and are ignored. When trace is set, every iteration
+// records its eigenvalue estimates and their change to it.
 template<class T>
 std::vector<std::pair<std::complex<T>,
                       Matrix<std::complex<T>>>> PowerMethodEigenvalues(
     const Matrix<T>& a,
     int* iters = nullptr,
     int max_iters = 100,
-    int check_iters = 10,
-    T converge_eps = Matrix<T>::GetEps(),
-    int force_method = -1) {
+    int /*check_iters*/ = 10,
+    T /*converge_eps*/ = Matrix<T>::GetEps(),
+    int force_method = -1,
+    ConvergenceTrace* trace = nullptr,
+    PowerAcceleration acceleration = PowerAcceleration::kNone) {
+  PROFILE_ZONE("PowerMethodEigenvalues");
   if (iters) {
     *iters = 0;
   }
-  if (force_method != -1) {
-    Matrix<T> y(a.Rows(), 1);
-    y(0) = 1;
-    switch (force_method) {
-      case 0: {
-        auto[e, v] =
-            __internal::PowerMethodEigenvalues1(a, y, iters, max_iters);
-        return {std::make_pair(e, v.ToComplex())};
-      }
-      case 1: {
-        return __internal::PowerMethodEigenvalues2(
-            a, y, iters, max_iters);
-      }
-      case 2: {
-        return __internal::PowerMethodEigenvalues3(
-            a, iters, max_iters);
-      }
-      default: {
-        break;
-      }
+  Matrix<T> y(a.Rows(), 1);
+  y(0) = 1;
+  switch (force_method) {
+    case 0: {
+      auto[e, v] = __internal::PowerMethodEigenvalues1(
+          a, y, iters, max_iters, trace, acceleration);
+      return {std::make_pair(e, v.ToComplex())};
     }
-  }
-  {
-    auto [converges, y] =
-        __internal::PowerIterationMethod2IterationConverges(
-            a, check_iters, converge_eps);
-    if (converges) {
-      int iters_ = 0;
-      auto res = __internal::PowerMethodEigenvalues2(
-          a, y, &iters_, max_iters);
-      if (iters_ >= 0 && !res.empty()) {
-        if (iters) {
-          *iters = check_iters + iters_;
-        }
-        return res;
-      }
+    case 1: {
+      return __internal::PowerMethodEigenvalues2(
+          a, y, iters, max_iters, Matrix<T>::GetEps(), trace, acceleration);
+    }
+    case 2: {
+      return __internal::PowerMethodEigenvalues3(
+          a, iters, max_iters, false, trace);
+    }
+    default: {
+      return SubspaceIteration(a, iters, max_iters, 4, Matrix<T>::GetEps(),
+                               trace);
     }
   }
-  // std::cerr << "Method 3\n";
-  return __internal::PowerMethodEigenvalues3(a, iters, max_iters);
 }
@@ -2,6 +2,8 @@
 
 #include <complex>
 #include "Matrix/matrix.h"
+#include "TimeMeasurer/scoped_profiler.h"
+#include "convergence_trace.h"
 #include "rotations.h"
 #include "eigenvalues.h"
 
@@ -35,30 +37,64 @@ bool DoDiagonalSquaresIntersect(const Matrix<T>& a) {
   return false;
 }
 
+namespace __internal {
+
+// Subdiagonal magnitudes after a sweep, and a deflation event the first time
+// one of them drops below eps.
+template<class T>
+void TraceSubdiagonal(const Matrix<T>& a,
+                      int iter,
+                      std::vector<char>& deflated,
+                      ConvergenceTrace* trace) {
+  for (int i = 0; i + 1 < a.Rows(); i++) {
+    double value = std::abs(a(i + 1, i));
+    trace->Record(TraceSolver::kQrAlgorithm, TraceEvent::kSubdiagonal, iter,
+                  i, value);
+    if (!deflated[i] && value < Matrix<T>::GetEps()) {
+      deflated[i] = true;
+      trace->Record(TraceSolver::kQrAlgorithm, TraceEvent::kDeflation, iter,
+                    i, value);
+    }
+  }
+}
+
+}
+
 template<class T>
 std::vector<std::complex<T>> QrAlgorithm(Matrix<T> a,
                                          int* iters = nullptr,
-                                         int max_iter = 1000) {
+                                         int max_iter = 1000,
+                                         ConvergenceTrace* trace = nullptr) {
+  PROFILE_ZONE("QrAlgorithm");
   if (!a.IsSquare()) {
     throw std::invalid_argument(
         "Matrix of size " + PairToString(a.Size()) + " is not square.");
   }
   int n = a.Rows();
+  std::vector<char> deflated(trace ? n : 0);
   int iter;
   for (iter = 0; iter < max_iter; iter++) {
-    std::vector<std::pair<T, T>> rotations;
-    rotations.reserve(n);
-    for (int i = 0; i < n - 1; i++) {
-      auto[sin, cos] = GetRotationMatrix(a.SubMatrix(i, i, 2, 1));
-      rotations.emplace_back(sin, cos);
-      ApplyRotation(a, sin, cos, i);
+    {
+      PROFILE_ZONE("QR sweep");
+      std::vector<std::pair<T, T>> rotations;
+      rotations.reserve(n);
+      for (int i = 0; i < n - 1; i++) {
+        auto[sin, cos] = GetRotationMatrix(a.SubMatrix(i, i, 2, 1));
+        rotations.emplace_back(sin, cos);
+        ApplyRotation(a, sin, cos, i);
+      }
+
+      for (int i = 0; i < n - 1; i++) {
+        auto[sin, cos] = rotations[i];
+        ApplyTransposedRotation(a, sin, cos, i);
+      }
     }
 
-    for (int i = 0; i < n - 1; i++) {
-      auto[sin, cos] = rotations[i];
-      ApplyTransposedRotation(a, sin, cos, i);
+    if (trace) {
+      __internal::TraceSubdiagonal(a, iter + 1, deflated, trace);
     }
 
+    PROFILE_ZONE("QR convergence check");
     if (DoDiagonalSquaresIntersect(a) ||
         UnderDiagonalZeros(a) < (n - 1) / 2) {
       continue;
@@ -76,6 +112,7 @@ std::vector<std::complex<T>> QrAlgorithm(Matrix<T> a,
     return {};
   }
 
+  PROFILE_ZONE("QR eigenvalue extraction");
   std::vector<std::complex<T>> ans;
   for (int i = 0; i < n; i++) {
     if (i == n - 1 || std::abs(a(i + 1, i)) < Matrix<T>::GetEps()) {
@@ -25,6 +25,9 @@ void ApplyRotation(Matrix<T>& a, T sin, T cos, int iter) {
         "Matrix of size " + PairToString(a.Size()) + " is not square.");
   }
   auto n = a.Rows();
+  COUNT_WORK((4 * __internal::Flops<T>::kMultiply +
+                2 * __internal::Flops<T>::kAdd) * (n - iter),
+             4 * sizeof(T) * (n - iter));
   for (int i = iter; i < n; i++) {
     T e1 = a(iter, i) * cos + a(iter + 1, i) * sin;
     T e2 = a(iter, i) * (-sin) + a(iter + 1, i) * cos;
@@ -39,6 +42,9 @@ void ApplyTransposedRotation(Matrix<T>& a, T sin, T cos, int iter) {
     throw std::invalid_argument(
         "Matrix of size " + PairToString(a.Size()) + " is not square.");
   }
+  COUNT_WORK((4 * __internal::Flops<T>::kMultiply +
+                2 * __internal::Flops<T>::kAdd) * (iter + 2),
+             4 * sizeof(T) * (iter + 2));
   for (int i = 0; i < iter + 2; i++) {
     T e1 = a(i, iter) * cos + a(i, iter + 1) * sin;
     T e2 = a(i, iter) * (-sin) + a(i, iter + 1) * cos;
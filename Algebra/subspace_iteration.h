@@ -0,0 +1,224 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <limits>
+#include <vector>
+#include "Matrix/matrix.h"
+#include "Matrix/counter_random.h"
+#include "Matrix/split_complex.h"
+#include "TimeMeasurer/scoped_profiler.h"
+#include "convergence_trace.h"
+#include "euclidean_norm.h"
+#include "gauss.h"
+#include "hessenberg_form.h"
+#include "qr_algorithm.h"
+
+namespace __internal {
+
+// Makes the columns of q orthonormal with modified Gram-Schmidt, run twice
+// so that they stay orthogonal to working precision. A column that lies in
+// the span of the previous ones becomes zero.
+template<class T>
+void Orthonormalize(Matrix<T>& q) {
+  int n = q.Rows();
+  for (int j = 0; j < q.Cols(); j++) {
+    auto col = q.Col(j);
+    auto before = EuclideanNorm<T>(col);
+    for (int pass = 0; pass < 2; pass++) {
+      for (int k = 0; k < j; k++) {
+        T r = 0;
+        for (int i = 0; i < n; i++) {
+          r += q(i, k) * q(i, j);
+        }
+        for (int i = 0; i < n; i++) {
+          q(i, j) -= r * q(i, k);
+        }
+      }
+    }
+    auto norm = EuclideanNorm<T>(col);
+    T scale = norm > before * std::numeric_limits<T>::epsilon() ? 1 / norm : 0;
+    for (int i = 0; i < n; i++) {
+      q(i, j) *= scale;
+    }
+  }
+  COUNT_WORK(4 * uint64_t(n) * q.Cols() * q.Cols(),
+             2 * sizeof(T) * uint64_t(n) * q.Cols() * q.Cols());
+}
+
+// Eigenpairs of the small matrix h, vectors by two steps of inverse
+// iteration with a slightly perturbed shift. Empty when the QR algorithm
+// doesn't converge.
+template<class T>
+std::vector<std::pair<std::complex<T>, Matrix<std::complex<T>>>> SmallEigenpairs(
+    const Matrix<T>& h, int max_iter) {
+  int p = h.Rows();
+  int qr_iters = 0;
+  auto values = QrAlgorithm(ReflectionsHessenberg(h), &qr_iters, max_iter);
+  std::vector<std::pair<std::complex<T>, Matrix<std::complex<T>>>> ans;
+  // GaussSolve skips pivots below |GetEps()| and takes x = 1 for the ones
+  // below 5 |GetEps()|; the shifted matrix has to stay clear of both, or the
+  // vector comes out of those guesses instead of the solve.
+  T shift = std::max<T>(std::sqrt(std::numeric_limits<T>::epsilon()),
+                        10 * std::abs(Matrix<std::complex<T>>::GetEps())) *
+            (EuclideanNorm<T>(h) + 1);
+  for (auto value: values) {
+    SplitComplexMatrix<T> shifted(h);
+    for (int i = 0; i < p; i++) {
+      shifted.Real()(i, i) -= value.real() + shift;
+      shifted.Imag()(i, i) -= value.imag();
+    }
+    SplitComplexMatrix<T> y(Matrix<T>(p, 1, 1));
+    for (int step = 0; step < 2; step++) {
+      y = GaussSolve(shifted, y).first;
+      auto norm = std::hypot(EuclideanNorm<T>(y.Real()),
+                             EuclideanNorm<T>(y.Imag()));
+      y.Real() /= norm;
+      y.Imag() /= norm;
+    }
+    ans.emplace_back(value, y.ToComplex());
+  }
+  return ans;
+}
+
+// Ritz values of the largest modulus, within tolerance of the first, ordered
+// by modulus and then by the parts so that they match between iterations.
+template<class T>
+void KeepDominant(
+    std::vector<std::pair<std::complex<T>, Matrix<std::complex<T>>>>& pairs,
+    T tolerance) {
+  std::sort(pairs.begin(), pairs.end(), [](const auto& l, const auto& r) {
+    auto lv = l.first;
+    auto rv = r.first;
+    if (std::abs(lv) != std::abs(rv)) {
+      return std::abs(lv) > std::abs(rv);
+    }
+    if (lv.real() != rv.real()) {
+      return lv.real() > rv.real();
+    }
+    return lv.imag() > rv.imag();
+  });
+  if (pairs.empty()) {
+    return;
+  }
+  T largest = std::abs(pairs[0].first);
+  tolerance = std::max(tolerance,
+                       std::sqrt(std::numeric_limits<T>::epsilon()) * largest);
+  int count = 1;
+  while (count < pairs.size() &&
+         largest - std::abs(pairs[count].first) <= tolerance) {
+    count++;
+  }
+  pairs.resize(count);
+  std::sort(pairs.begin(), pairs.end(), [](const auto& l, const auto& r) {
+    if (l.first.real() != r.first.real()) {
+      return l.first.real() > r.first.real();
+    }
+    return l.first.imag() > r.first.imag();
+  });
+}
+
+// SubspaceIteration from the orthonormal block q, which is left holding the
+// block the returned Ritz vectors come from.
+template<class T>
+std::vector<std::pair<std::complex<T>,
+                      Matrix<std::complex<T>>>> SubspaceIterationFrom(
+    const Matrix<T>& a,
+    Matrix<T>& q,
+    int* iters,
+    int max_iters,
+    T eps,
+    ConvergenceTrace* trace) {
+  int n = a.Rows();
+  std::vector<std::pair<std::complex<T>, Matrix<std::complex<T>>>> ritz;
+  std::vector<std::complex<T>> prev;
+  int iter = 0;
+  bool converged = false;
+  while (n > 0) {
+    auto z = a * q;
+    ritz = SmallEigenpairs(q.Transposed() * z, 10 * max_iters);
+    KeepDominant(ritz, eps);
+    iter++;
+    T change = std::numeric_limits<T>::infinity();
+    if (prev.size() == ritz.size() && !ritz.empty()) {
+      change = 0;
+      for (int k = 0; k < ritz.size(); k++) {
+        change = std::max<T>(change, std::abs(ritz[k].first - prev[k]));
+      }
+    }
+    prev.clear();
+    for (int k = 0; k < ritz.size(); k++) {
+      prev.push_back(ritz[k].first);
+      if (trace) {
+        trace->Record(TraceSolver::kSubspaceIteration, TraceEvent::kEigenvalue,
+                      iter, k, std::complex<double>(ritz[k].first));
+      }
+    }
+    if (trace) {
+      trace->Record(TraceSolver::kSubspaceIteration, TraceEvent::kResidual,
+                    iter, 0, static_cast<double>(change));
+    }
+    converged = change <= eps;
+    if (converged || iter > max_iters) {
+      break;
+    }
+    q = std::move(z);
+    Orthonormalize(q);
+  }
+
+  // Ritz vectors: the small eigenvectors taken back through the block the
+  // last projection was made from. Settled values come with residuals far
+  // below sqrt(eps) (|lambda| + 1); a larger one means a vector gone wrong,
+  // and the result doesn't count as converged.
+  std::vector<std::pair<std::complex<T>, Matrix<std::complex<T>>>> ans;
+  for (auto& [value, y]: ritz) {
+    auto x = q * y;
+    x /= EuclideanNorm<std::complex<T>>(x);
+    if (converged && EuclideanNorm<T>(a * x - value * x) >
+                         std::sqrt(eps) * (std::abs(value) + 1)) {
+      converged = false;
+    }
+    ans.emplace_back(value, std::move(x));
+  }
+  if (iters) {
+    *iters = converged ? iter : -1;
+  }
+  return ans;
+}
+
+}
+
+// Dominant eigenpairs of a by orthogonal (block power) iteration: a block of
+// block_size orthonormal vectors is multiplied by a and orthonormalized
+// again, and the Rayleigh-Ritz projection Q^T A Q of every block gives the
+// estimates. Every eigenvalue of the largest modulus is returned, so a
+// single one, a pair +-lambda and a complex conjugate pair take the same
+// path; the block only has to be wider than their number. Convergence goes
+// as |lambda_{block_size + 1} / lambda_1| per iteration and stops once the
+// estimates change by less than eps. *iters is the number of block
+// multiplications, -1 when max_iters were not enough.
+template<class T>
+std::vector<std::pair<std::complex<T>,
+                      Matrix<std::complex<T>>>> SubspaceIteration(
+    const Matrix<T>& a,
+    int* iters = nullptr,
+    int max_iters = 100,
+    int block_size = 4,
+    T eps = Matrix<T>::GetEps(),
+    ConvergenceTrace* trace = nullptr) {
+  PROFILE_ZONE("SubspaceIteration");
+  if (!a.IsSquare()) {
+    throw std::invalid_argument(
+        "Matrix of size " + PairToString(a.Size()) + " is not square.");
+  }
+  if (block_size <= 0) {
+    throw std::invalid_argument("Block should have at least one vector");
+  }
+  int n = a.Rows();
+  int p = std::min(block_size, n);
+  // Fixed random start, so that runs are reproducible.
+  auto q = CounterRandomMatrix<T>(n, p, -1, 1, 0x5eed);
+  __internal::Orthonormalize(q);
+  return __internal::SubspaceIterationFrom(a, q, iters, max_iters, eps, trace);
+}
@@ -0,0 +1,26 @@
+#include <fstream>
+#include <stdexcept>
+#include "append_file.h"
+
+#ifdef __unix__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+void AppendToFile(const std::string& path, const std::string& data) {
+#ifdef __unix__
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (fd < 0 || write(fd, data.data(), data.size()) != data.size()) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    throw std::runtime_error("Can't append to " + path);
+  }
+  close(fd);
+#else
+  std::ofstream out(path, std::ios::app | std::ios::binary);
+  if (!(out << data << std::flush)) {
+    throw std::runtime_error("Can't append to " + path);
+  }
+#endif
+}
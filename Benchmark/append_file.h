@@ -0,0 +1,7 @@
+#pragma once
+
+#include <string>
+
+// Appends data with one O_APPEND write, so records appended by several
+// processes at once never interleave. Throws std::runtime_error on failure.
+void AppendToFile(const std::string& path, const std::string& data);
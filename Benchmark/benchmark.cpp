@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include "benchmark.h"
+#include "TimeMeasurer/time_measurer.h"
+
+namespace {
+
+std::vector<std::string> Split(const std::string& s, char delimiter) {
+  std::vector<std::string> ans;
+  std::stringstream ss(s);
+  std::string item;
+  while (std::getline(ss, item, delimiter)) {
+    if (!item.empty()) {
+      ans.push_back(item);
+    }
+  }
+  return ans;
+}
+
+int ParseInt(const std::string& flag, const std::string& value) {
+  try {
+    size_t pos = 0;
+    auto ans = std::stoi(value, &pos);
+    if (pos == value.size()) {
+      return ans;
+    }
+  } catch (const std::logic_error&) {}
+  throw std::invalid_argument("Bad value '" + value + "' for " + flag);
+}
+
+double ParseDouble(const std::string& flag, const std::string& value) {
+  try {
+    size_t pos = 0;
+    auto ans = std::stod(value, &pos);
+    if (pos == value.size()) {
+      return ans;
+    }
+  } catch (const std::logic_error&) {}
+  throw std::invalid_argument("Bad value '" + value + "' for " + flag);
+}
+
+}
+
+double BenchmarkResult::Percentile(double p) const {
+  if (times.empty()) {
+    return 0;
+  }
+  auto sorted = times;
+  std::sort(sorted.begin(), sorted.end());
+  double pos = p / 100 * (sorted.size() - 1);
+  auto lo = static_cast<size_t>(pos);
+  auto hi = std::min(lo + 1, sorted.size() - 1);
+  return sorted[lo] + (sorted[hi] - sorted[lo]) * (pos - lo);
+}
+
+double BenchmarkResult::Median() const {
+  return Percentile(50);
+}
+
+double BenchmarkResult::Min() const {
+  return times.empty() ? 0 : *std::min_element(times.begin(), times.end());
+}
+
+double BenchmarkResult::Max() const {
+  return times.empty() ? 0 : *std::max_element(times.begin(), times.end());
+}
+
+void BenchmarkRegistry::Register(BenchmarkSuite suite) {
+  suites_.push_back(std::move(suite));
+}
+
+const std::vector<BenchmarkSuite>& BenchmarkRegistry::GetSuites() const {
+  return suites_;
+}
+
+const BenchmarkSuite& BenchmarkRegistry::GetSuite(
+    const std::string& name) const {
+  for (const auto& suite: suites_) {
+    if (suite.name == name) {
+      return suite;
+    }
+  }
+  throw std::invalid_argument("Unknown suite '" + name + "'");
+}
+
+BenchmarkResult BenchmarkRegistry::Run(const BenchmarkSuite& suite,
+                                       int size,
+                                       const BenchmarkOptions& options) const {
+  BenchmarkResult result{suite.name, size, {}};
+  result.times.reserve(options.repetitions);
+  PerfCounters counters;
+  for (int i = 0; i < options.repetitions; i++) {
+    BenchmarkCase benchmark_case{size, options.seed + i, options.thread_num,
+                                 options.min, options.max};
+    auto body = suite.prepare(benchmark_case);
+    if (i == 0) {
+      for (int j = 0; j < options.warmups; j++) {
+        body();
+      }
+    }
+    TimeMeasurer time_measurer;
+    {
+      ScopedPerfCounters scoped_counters(counters, &result.counters);
+      ScopedWorkCounter scoped_work(&result.work);
+      body();
+    }
+    result.times.push_back(time_measurer.GetDuration());
+  }
+  return result;
+}
+
+BenchmarkOptions ParseBenchmarkOptions(int argc, char** argv) {
+  BenchmarkOptions options;
+  for (int i = 1; i < argc; i++) {
+    std::string flag = argv[i];
+    if (flag == "--help" || flag == "-h") {
+      options.help = true;
+      continue;
+    }
+    if (flag == "--list") {
+      options.list = true;
+      continue;
+    }
+    if (i + 1 == argc) {
+      throw std::invalid_argument("Missing value for " + flag);
+    }
+    std::string value = argv[++i];
+    if (flag == "--suite") {
+      options.suites = Split(value, ',');
+    } else if (flag == "--sizes") {
+      options.sizes.clear();
+      for (const auto& size: Split(value, ',')) {
+        options.sizes.push_back(ParseInt(flag, size));
+      }
+    } else if (flag == "--repetitions") {
+      options.repetitions = ParseInt(flag, value);
+    } else if (flag == "--warmups") {
+      options.warmups = ParseInt(flag, value);
+    } else if (flag == "--seed") {
+      options.seed = ParseInt(flag, value);
+    } else if (flag == "--threads") {
+      options.thread_num = ParseInt(flag, value);
+    } else if (flag == "--min") {
+      options.min = ParseDouble(flag, value);
+    } else if (flag == "--max") {
+      options.max = ParseDouble(flag, value);
+    } else if (flag == "--output") {
+      options.output = value;
+    } else {
+      throw std::invalid_argument("Unknown flag " + flag);
+    }
+  }
+  if (options.repetitions < 1 || options.warmups < 0 ||
+      options.thread_num < 1 || options.sizes.empty()) {
+    throw std::invalid_argument("Bad benchmark options");
+  }
+  return options;
+}
+
+std::string BenchmarkUsage() {
+  return "Usage: benchmark [--list] [--suite a,b|all] [--sizes 50,100]\n"
+         "                 [--repetitions 5] [--warmups 1] [--seed 8917293]\n"
+         "                 [--threads 1] [--min -100] [--max 100]\n"
+         "                 [--output results.csv]\n";
+}
+
+void WriteBenchmarkHeader(std::ostream& out) {
+  out << "suite,size,repetitions,median,p10,p90,min,max,"
+         "cycles,instructions,ipc,cache_miss_rate,branch_misses,"
+         "flops,bytes,gflops,intensity\n";
+}
+
+void WriteBenchmarkResult(std::ostream& out, const BenchmarkResult& result) {
+  out << result.suite << ',' << result.size << ',' << result.times.size()
+      << std::setprecision(6) << std::scientific
+      << ',' << result.Median()
+      << ',' << result.Percentile(10)
+      << ',' << result.Percentile(90)
+      << ',' << result.Min()
+      << ',' << result.Max();
+  // Counters are per repetition and left empty when they are unavailable.
+  const auto& counters = result.counters;
+  if (counters.valid && !result.times.empty()) {
+    auto n = result.times.size();
+    out << ',' << counters.cycles / n
+        << ',' << counters.instructions / n
+        << ',' << counters.InstructionsPerCycle()
+        << ',' << counters.CacheMissRate()
+        << ',' << counters.branch_misses / n;
+  } else {
+    out << ",,,,,";
+  }
+  // Work is empty unless LINEAR_ALGEBRA_COUNT_WORK is on. GFLOP/s is taken
+  // against the median time.
+  const auto& work = result.work;
+  if (work.flops > 0 && !result.times.empty()) {
+    auto n = result.times.size();
+    out << ',' << work.flops / n
+        << ',' << work.bytes / n
+        << ',' << work.flops / n / result.Median() * 1e-9
+        << ',' << work.ArithmeticIntensity();
+  } else {
+    out << ",,,,";
+  }
+  out << '\n' << std::defaultfloat;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "Matrix/work_counter.h"
+#include "TimeMeasurer/perf_counters.h"
+
+// Parameters of a single measured case. A suite builds its input from them
+// and returns the function to be timed.
+struct BenchmarkCase {
+  int size;
+  int seed;
+  int thread_num;
+  double min;
+  double max;
+};
+
+struct BenchmarkSuite {
+  std::string name;
+  std::string description;
+  std::function<std::function<void()>(const BenchmarkCase&)> prepare;
+};
+
+struct BenchmarkOptions {
+  std::vector<std::string> suites;
+  std::vector<int> sizes{50, 100, 200};
+  int repetitions = 5;
+  int warmups = 1;
+  int seed = 8917293;
+  int thread_num = 1;
+  double min = -100;
+  double max = 100;
+  std::string output;
+  bool list = false;
+  bool help = false;
+};
+
+// Timings of one suite on one size, in seconds, the hardware counters of the
+// calling thread and the counted work, both summed over the timed
+// repetitions.
+struct BenchmarkResult {
+  std::string suite;
+  int size;
+  std::vector<double> times;
+  PerfSample counters{true};
+  WorkSample work{};
+
+  double Percentile(double p) const;
+  double Median() const;
+  double Min() const;
+  double Max() const;
+};
+
+class BenchmarkRegistry {
+ public:
+  void Register(BenchmarkSuite suite);
+  const std::vector<BenchmarkSuite>& GetSuites() const;
+  const BenchmarkSuite& GetSuite(const std::string& name) const;
+
+  // Every repetition gets a fresh input generated from seed + repetition,
+  // warm-ups use the first repetition's input.
+  BenchmarkResult Run(const BenchmarkSuite& suite,
+                      int size,
+                      const BenchmarkOptions& options) const;
+
+ private:
+  std::vector<BenchmarkSuite> suites_;
+};
+
+BenchmarkOptions ParseBenchmarkOptions(int argc, char** argv);
+std::string BenchmarkUsage();
+
+void WriteBenchmarkHeader(std::ostream& out);
+void WriteBenchmarkResult(std::ostream& out, const BenchmarkResult& result);
@@ -0,0 +1,264 @@
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include "benchmark.h"
+#include "Matrix/matrix.h"
+#include "Matrix/counter_random.h"
+#include "Matrix/matrix_market.h"
+#include "Algebra/companion_qr.h"
+#include "Algebra/continuation.h"
+#include "Algebra/danilevski_eigenvalues.h"
+#include "Algebra/deflation.h"
+#include "Algebra/exact_characteristic_polynomial.h"
+#include "Algebra/frobenius_form.h"
+#include "Algebra/hessenberg_form.h"
+#include "Algebra/polynomial_roots.h"
+#include "Algebra/power_iteration_method.h"
+#include "Algebra/qr_algorithm.h"
+#include "TimeMeasurer/scoped_profiler.h"
+
+namespace {
+
+DMatrix RandomMatrix(const BenchmarkCase& c) {
+  return CounterRandomMatrix(c.size, c.size, c.min, c.max, c.seed);
+}
+
+void RegisterPowerMethod(BenchmarkRegistry& registry,
+                         const std::string& name,
+                         int method) {
+  registry.Register({name, "PowerMethodEigenvalues, force_method = " +
+      std::to_string(method) + ", 1000 iterations at most",
+                     [method](const BenchmarkCase& c) {
+                       auto a = RandomMatrix(c);
+                       return std::function<void()>([a, method]() {
+                         int iters = 0;
+                         PowerMethodEigenvalues(a, &iters, 1000, 10,
+                                                Matrix<double>::GetEps(),
+                                                method);
+                       });
+                     }});
+}
+
+BenchmarkRegistry MakeRegistry() {
+  BenchmarkRegistry registry;
+  RegisterPowerMethod(registry, "power1", 0);
+  RegisterPowerMethod(registry, "power2", 1);
+  RegisterPowerMethod(registry, "power3", 2);
+  RegisterPowerMethod(registry, "power_auto", -1);
+
+  registry.Register({"deflation",
+                     "DeflatedPowerMethod, 10 largest eigenvalues of a "
+                     "symmetric matrix",
+                     [](const BenchmarkCase& c) {
+                       auto a = RandomMatrix(c);
+                       a = a + a.Transposed();
+                       return std::function<void()>([a]() {
+                         int iters = 0;
+                         DeflatedPowerMethod(a, 10, &iters, 10000);
+                       });
+                     }});
+
+  registry.Register({"continuation",
+                     "EigenContinuation::Dominant along A + t B, t = 0, "
+                     "0.01, ..., 0.19, symmetric",
+                     [](const BenchmarkCase& c) {
+                       auto a = RandomMatrix(c);
+                       a = a + a.Transposed();
+                       auto b = CounterRandomMatrix(c.size, c.size, c.min,
+                                                    c.max, c.seed, 1);
+                       b = b + b.Transposed();
+                       return std::function<void()>([a, b]() {
+                         EigenContinuation<double> continuation;
+                         for (int step = 0; step < 20; step++) {
+                           int iters = 0;
+                           continuation.Dominant(a + b * (0.01 * step),
+                                                 &iters, 1000);
+                         }
+                       });
+                     }});
+
+  registry.Register({"eigenvectors",
+                     "FindEigenvectorsByValues of a real matrix at 10 "
+                     "complex shifts",
+                     [](const BenchmarkCase& c) {
+                       auto a = RandomMatrix(c);
+                       std::vector<std::complex<double>> values;
+                       for (int k = 0; k < 10; k++) {
+                         values.emplace_back(0.1 * k, 0.05 * k);
+                       }
+                       return std::function<void()>([a, values]() {
+                         FindEigenvectorsByValues(a, values);
+                       });
+                     }});
+
+  registry.Register({"hessenberg", "ReflectionsHessenberg",
+                     [](const BenchmarkCase& c) {
+                       auto a = RandomMatrix(c);
+                       return std::function<void()>([a]() {
+                         ReflectionsHessenberg(a);
+                       });
+                     }});
+  registry.Register({"qr", "QrAlgorithm on the Hessenberg form",
+                     [](const BenchmarkCase& c) {
+                       auto h = ReflectionsHessenberg(RandomMatrix(c));
+                       return std::function<void()>([h]() {
+                         int iters = 0;
+                         QrAlgorithm(h, &iters, 1000);
+                       });
+                     }});
+  registry.Register({"frobenius", "FrobeniusForm, blocked",
+                     [](const BenchmarkCase& c) {
+                       auto a = RandomMatrix(c);
+                       return std::function<void()>([a]() {
+                         FrobeniusForm(a);
+                       });
+                     }});
+  registry.Register({"frobenius_scalar", "FrobeniusForm, block_size = 1",
+                     [](const BenchmarkCase& c) {
+                       auto a = RandomMatrix(c);
+                       return std::function<void()>([a]() {
+                         FrobeniusForm(a, nullptr, 1);
+                       });
+                     }});
+  registry.Register({"danilevski_roots",
+                     "FrobeniusForm, DanilevskiPolynomial and FindRoots",
+                     [](const BenchmarkCase& c) {
+                       auto a = RandomMatrix(c);
+                       return std::function<void()>([a]() {
+                         for (const auto& p:
+                             DanilevskiPolynomial(FrobeniusForm(a))) {
+                           FindRoots(p, 1e-6, 0.1);
+                         }
+                       });
+                     }});
+  registry.Register({"danilevski_companion_qr",
+                     "FrobeniusForm and DanilevskiCompanionQr",
+                     [](const BenchmarkCase& c) {
+                       auto a = RandomMatrix(c);
+                       return std::function<void()>([a]() {
+                         DanilevskiCompanionQr(FrobeniusForm(a));
+                       });
+                     }});
+  registry.Register({"exact_charpoly",
+                     "ExactCharacteristicPolynomial of an integer matrix",
+                     [](const BenchmarkCase& c) {
+                       auto a = CounterRandomInts<double>(c.size, c.size,
+                                                          -10, 10, c.seed);
+                       int thread_num = c.thread_num;
+                       return std::function<void()>([a, thread_num]() {
+                         ExactCharacteristicPolynomial(a, thread_num);
+                       });
+                     }});
+  registry.Register({"counter_random",
+                     "CounterRandomMatrix filled on --threads threads",
+                     [](const BenchmarkCase& c) {
+                       return std::function<void()>([c]() {
+                         CounterRandomMatrix(c.size, c.size, c.min, c.max,
+                                             c.seed, 0, c.thread_num);
+                       });
+                     }});
+  registry.Register({"matrix_market",
+                     "ReadMatrixMarket of a dense real file on --threads "
+                     "threads",
+                     [](const BenchmarkCase& c) {
+                       auto path = (std::filesystem::temp_directory_path() /
+                           "benchmark_matrix_market.mtx").string();
+                       auto a = RandomMatrix(c);
+                       std::ofstream out(path);
+                       out << "%%MatrixMarket matrix array real general\n"
+                           << a.Rows() << ' ' << a.Cols() << '\n';
+                       char buffer[32];
+                       for (int j = 0; j < a.Cols(); j++) {
+                         for (int i = 0; i < a.Rows(); i++) {
+                           std::snprintf(buffer, sizeof(buffer), "%.17g\n",
+                                         a(i, j));
+                           out << buffer;
+                         }
+                       }
+                       return std::function<void()>([path, c]() {
+                         ReadMatrixMarket<double>(path, c.thread_num);
+                       });
+                     }});
+  registry.Register({"gemm", "Matrix product of two random matrices",
+                     [](const BenchmarkCase& c) {
+                       auto a = RandomMatrix(c);
+                       auto b = CounterRandomMatrix(c.size, c.size, c.min,
+                                                    c.max, c.seed, 1);
+                       // The product goes somewhere, so that it can't be
+                       // optimized away.
+                       auto sink = std::make_shared<double>();
+                       return std::function<void()>([a, b, sink]() {
+                         *sink += (a * b)(0, 0);
+                       });
+                     }});
+  return registry;
+}
+
+}
+
+int main(int argc, char** argv) {
+  Matrix<double>::SetEps(1e-6, 6);
+  Matrix<std::complex<double>>::SetEps(std::complex<double>(1e-6, 1e-6), 6);
+
+  BenchmarkOptions options;
+  try {
+    options = ParseBenchmarkOptions(argc, argv);
+  } catch (const std::invalid_argument& e) {
+    std::cerr << e.what() << '\n' << BenchmarkUsage();
+    return 1;
+  }
+  if (options.help) {
+    std::cout << BenchmarkUsage();
+    return 0;
+  }
+
+  auto registry = MakeRegistry();
+  if (options.list || options.suites.empty()) {
+    for (const auto& suite: registry.GetSuites()) {
+      std::cout << suite.name << " - " << suite.description << '\n';
+    }
+    return 0;
+  }
+
+  std::vector<const BenchmarkSuite*> suites;
+  try {
+    for (const auto& name: options.suites) {
+      if (name == "all") {
+        for (const auto& suite: registry.GetSuites()) {
+          suites.push_back(&suite);
+        }
+      } else {
+        suites.push_back(&registry.GetSuite(name));
+      }
+    }
+  } catch (const std::invalid_argument& e) {
+    std::cerr << e.what() << '\n';
+    return 1;
+  }
+
+  std::ofstream file;
+  if (!options.output.empty()) {
+    file.open(options.output);
+    if (!file) {
+      std::cerr << "Cannot open " << options.output << '\n';
+      return 1;
+    }
+    WriteBenchmarkHeader(file);
+  }
+  WriteBenchmarkHeader(std::cout);
+  for (const auto* suite: suites) {
+    for (auto size: options.sizes) {
+      auto result = registry.Run(*suite, size, options);
+      WriteBenchmarkResult(std::cout, result);
+      if (file.is_open()) {
+        WriteBenchmarkResult(file, result);
+      }
+    }
+  }
+#ifdef LINEAR_ALGEBRA_PROFILE
+  Profiler::Report(std::cerr);
+#endif
+  return 0;
+}
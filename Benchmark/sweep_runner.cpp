@@ -0,0 +1,158 @@
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include "sweep_runner.h"
+#include "append_file.h"
+
+namespace {
+
+bool HasSpace(const std::string& s) {
+  return s.empty() || s.find_first_of(" \t\n=;") != std::string::npos;
+}
+
+// Parses a complete checkpoint line, returns false for a torn or foreign one.
+bool ParseLine(const std::string& line, SweepCell* cell, SweepMetrics* metrics) {
+  std::stringstream ss(line);
+  if (!(ss >> cell->size >> cell->seed >> cell->method)) {
+    return false;
+  }
+  std::string item;
+  while (ss >> item) {
+    if (item == ";") {
+      return true;
+    }
+    auto pos = item.find('=');
+    if (pos == std::string::npos) {
+      return false;
+    }
+    try {
+      (*metrics)[item.substr(0, pos)] = std::stod(item.substr(pos + 1));
+    } catch (const std::logic_error&) {
+      return false;
+    }
+  }
+  return false;
+}
+
+// Whether the file ends in the middle of a line, which only a crash leaves.
+bool HasTornLine(const std::string& path) {
+  std::ifstream in(path, std::ios::binary | std::ios::ate);
+  if (!in || in.tellg() <= 0) {
+    return false;
+  }
+  in.seekg(-1, std::ios::end);
+  return in.get() != '\n';
+}
+
+}
+
+SweepRunner::SweepRunner(std::string checkpoint_path,
+                         int shard,
+                         int shard_count)
+    : path_(std::move(checkpoint_path)),
+      shard_(shard),
+      shard_count_(shard_count) {
+  if (shard_count < 1 || shard < 0 || shard >= shard_count) {
+    throw std::invalid_argument(
+        "Bad shard " + std::to_string(shard) + " of " +
+        std::to_string(shard_count));
+  }
+  if (HasTornLine(path_)) {
+    AppendToFile(path_, "\n");
+  }
+  Reload();
+}
+
+void SweepRunner::Run(
+    const std::vector<SweepCell>& cells,
+    const std::function<SweepMetrics(const SweepCell&)>& body,
+    int thread_num) {
+  std::vector<const SweepCell*> todo;
+  for (int i = shard_; i < cells.size(); i += shard_count_) {
+    if (HasSpace(cells[i].method)) {
+      throw std::invalid_argument(
+          "Bad method name '" + cells[i].method + "'");
+    }
+    if (!Find(cells[i])) {
+      todo.push_back(&cells[i]);
+    }
+  }
+  std::atomic<int> next{0};
+  auto thread_main = [&]() {
+    for (int i = next++; i < todo.size(); i = next++) {
+      Append(*todo[i], body(*todo[i]));
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int i = 1; i < thread_num; i++) {
+    threads.emplace_back(thread_main);
+  }
+  thread_main();
+  for (auto& thread: threads) {
+    thread.join();
+  }
+}
+
+void SweepRunner::Reload() {
+  std::ifstream in(path_);
+  std::string line;
+  std::map<Key, SweepMetrics> done;
+  while (std::getline(in, line)) {
+    SweepCell cell;
+    SweepMetrics metrics;
+    if (ParseLine(line, &cell, &metrics)) {
+      done[ToKey(cell)] = std::move(metrics);
+    }
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  done_ = std::move(done);
+}
+
+void SweepRunner::WaitFor(const std::vector<SweepCell>& cells) {
+  while (!IsComplete(cells)) {
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    Reload();
+  }
+}
+
+std::optional<SweepMetrics> SweepRunner::Find(const SweepCell& cell) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = done_.find(ToKey(cell));
+  if (it == done_.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+bool SweepRunner::IsComplete(const std::vector<SweepCell>& cells) const {
+  for (const auto& cell: cells) {
+    if (!Find(cell)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+SweepRunner::Key SweepRunner::ToKey(const SweepCell& cell) {
+  return {cell.size, cell.seed, cell.method};
+}
+
+void SweepRunner::Append(const SweepCell& cell, const SweepMetrics& metrics) {
+  std::stringstream ss;
+  ss.precision(std::numeric_limits<double>::max_digits10);
+  ss << cell.size << ' ' << cell.seed << ' ' << cell.method;
+  for (const auto&[name, value]: metrics) {
+    if (HasSpace(name)) {
+      throw std::invalid_argument("Bad metric name '" + name + "'");
+    }
+    ss << ' ' << name << '=' << value;
+  }
+  ss << " ;\n";
+  std::lock_guard<std::mutex> lock(mutex_);
+  AppendToFile(path_, ss.str());
+  done_[ToKey(cell)] = metrics;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// One point of a parameter sweep. The method name must not contain spaces.
+struct SweepCell {
+  int size;
+  int seed;
+  std::string method;
+};
+
+using SweepMetrics = std::map<std::string, double>;
+
+// Runs sweeps that survive being killed. Every finished cell is appended to
+// the checkpoint file as one line
+//   size seed method name=value ... ;
+// and cells already in the file are skipped, so a restarted job only does
+// what is left. The trailing ';' marks a complete line; a line cut short by
+// a crash is ignored and its cell is run again.
+//
+// Several processes may share one checkpoint file, each with its own shard
+// of every cell list: cell i belongs to shard i % shard_count. Lines are
+// appended with single O_APPEND writes, so they never interleave. Reload()
+// picks up what the other processes finished.
+class SweepRunner {
+ public:
+  explicit SweepRunner(std::string checkpoint_path,
+                       int shard = 0,
+                       int shard_count = 1);
+
+  // Runs the unfinished cells of this shard on thread_num threads.
+  void Run(const std::vector<SweepCell>& cells,
+           const std::function<SweepMetrics(const SweepCell&)>& body,
+           int thread_num = 1);
+
+  void Reload();
+  // Rereads the checkpoint until every cell is finished by some shard.
+  void WaitFor(const std::vector<SweepCell>& cells);
+
+  std::optional<SweepMetrics> Find(const SweepCell& cell) const;
+  // Whether every cell, of any shard, is finished.
+  bool IsComplete(const std::vector<SweepCell>& cells) const;
+
+ private:
+  using Key = std::tuple<int, int, std::string>;
+
+  static Key ToKey(const SweepCell& cell);
+  void Append(const SweepCell& cell, const SweepMetrics& metrics);
+
+  std::string path_;
+  int shard_;
+  int shard_count_;
+  mutable std::mutex mutex_;
+  std::map<Key, SweepMetrics> done_;
+};
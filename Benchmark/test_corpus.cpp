@@ -0,0 +1,246 @@
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include "test_corpus.h"
+#include "append_file.h"
+
+#ifdef __unix__
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+struct RecordHeader {
+  char tag[4];
+  uint32_t payload_size;
+  int32_t size;
+  int32_t seed;
+  double min;
+  double max;
+  int32_t iters;
+  int32_t padding;
+  double time;
+};
+
+size_t PaddedSize(size_t size) {
+  return (size + 7) / 8 * 8;
+}
+
+void AppendString(std::string& out, const std::string& s) {
+  uint32_t size = s.size();
+  out.append(reinterpret_cast<const char*>(&size), sizeof(size));
+  out.append(s);
+  out.append(PaddedSize(sizeof(size) + s.size()) - sizeof(size) - s.size(),
+             '\0');
+}
+
+// Reads a string at *offset within [*offset, end), false if it runs past.
+bool ReadString(const char* data, size_t* offset, size_t end, std::string* s) {
+  uint32_t size;
+  if (*offset + sizeof(size) > end) {
+    return false;
+  }
+  std::memcpy(&size, data + *offset, sizeof(size));
+  auto next = *offset + PaddedSize(sizeof(size) + size);
+  if (next > end) {
+    return false;
+  }
+  s->assign(data + *offset + sizeof(size), size);
+  *offset = next;
+  return true;
+}
+
+// Exclusive flock on the corpus file while it lives. Appends hold it, so
+// whoever holds it sees no record half written by another process.
+class FileLock {
+ public:
+  explicit FileLock(const std::string& path) {
+#ifdef __unix__
+    fd_ = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd_ < 0) {
+      throw std::runtime_error("Can't open corpus " + path);
+    }
+    if (flock(fd_, LOCK_EX) != 0) {
+      close(fd_);
+      throw std::runtime_error("Can't lock corpus " + path);
+    }
+#endif
+  }
+
+  ~FileLock() {
+#ifdef __unix__
+    flock(fd_, LOCK_UN);
+    close(fd_);
+#endif
+  }
+
+  FileLock(const FileLock&) = delete;
+  FileLock& operator=(const FileLock&) = delete;
+
+ private:
+  int fd_ = -1;
+};
+
+}
+
+TestCorpus::TestCorpus(std::string path) : path_(std::move(path)) {
+  // Under the lock an incomplete tail can only be left by a crash.
+  FileLock lock(path_);
+  Map();
+  indexed_ = Index(0);
+  if (indexed_ < size_) {
+    Unmap();
+    std::filesystem::resize_file(path_, indexed_);
+    Map();
+  }
+}
+
+TestCorpus::~TestCorpus() {
+  Unmap();
+}
+
+std::optional<CorpusEntry> TestCorpus::Find(const CorpusKey& key) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = offsets_.find(ToKey(key));
+  if (it == offsets_.end()) {
+    return std::nullopt;
+  }
+  RecordHeader header;
+  std::memcpy(&header, data_ + it->second, sizeof(header));
+  auto offset = it->second + sizeof(header);
+  for (int i = 0; i < 2; i++) {
+    uint32_t size;
+    std::memcpy(&size, data_ + offset, sizeof(size));
+    offset += PaddedSize(sizeof(size) + size);
+  }
+  auto entries = reinterpret_cast<const double*>(data_ + offset);
+  CorpusEntry ans{DMatrix(header.size, header.size),
+                  {header.iters, header.time}};
+  for (int i = 0; i < header.size; i++) {
+    for (int j = 0; j < header.size; j++) {
+      ans.matrix(i, j) = entries[i * header.size + j];
+    }
+  }
+  return ans;
+}
+
+void TestCorpus::Add(const CorpusKey& key, const CorpusEntry& entry) {
+  if (entry.matrix.Rows() != key.size || entry.matrix.Cols() != key.size) {
+    throw std::invalid_argument(
+        "Matrix of size " + PairToString(entry.matrix.Size()) +
+        " for corpus size " + std::to_string(key.size));
+  }
+  std::string record(sizeof(RecordHeader), '\0');
+  AppendString(record, key.generator);
+  AppendString(record, key.check);
+  for (int i = 0; i < key.size; i++) {
+    for (int j = 0; j < key.size; j++) {
+      double value = entry.matrix(i, j);
+      record.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+  }
+  RecordHeader header{{'M', 'T', 'R', 'X'},
+                      static_cast<uint32_t>(record.size() - 8),
+                      key.size, key.seed, key.min, key.max,
+                      entry.outcome.iters, 0, entry.outcome.time};
+  std::memcpy(record.data(), &header, sizeof(header));
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (offsets_.count(ToKey(key)) != 0) {
+    return;
+  }
+  {
+    FileLock file_lock(path_);
+    AppendToFile(path_, record);
+  }
+  // Picks up whatever other processes appended meanwhile as well.
+  Map();
+  indexed_ = Index(indexed_);
+}
+
+CorpusEntry TestCorpus::GetOrCreate(
+    const CorpusKey& key,
+    const std::function<DMatrix()>& generate,
+    const std::function<CorpusOutcome(const DMatrix&)>& check) {
+  if (auto entry = Find(key)) {
+    return *entry;
+  }
+  CorpusEntry entry{generate(), {}};
+  entry.outcome = check(entry.matrix);
+  Add(key, entry);
+  return entry;
+}
+
+size_t TestCorpus::Size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return offsets_.size();
+}
+
+TestCorpus::Key TestCorpus::ToKey(const CorpusKey& key) {
+  return {key.generator, key.check, key.size, key.seed, key.min, key.max};
+}
+
+void TestCorpus::Map() {
+  Unmap();
+  std::error_code error;
+  auto size = std::filesystem::file_size(path_, error);
+  if (error || size == 0) {
+    return;
+  }
+#ifdef __unix__
+  int fd = open(path_.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Can't open corpus " + path_);
+  }
+  void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    throw std::runtime_error("Can't map corpus " + path_);
+  }
+  data_ = static_cast<const char*>(data);
+#else
+  buffer_.resize(size);
+  std::ifstream in(path_, std::ios::binary);
+  if (!in.read(buffer_.data(), size)) {
+    throw std::runtime_error("Can't read corpus " + path_);
+  }
+  data_ = buffer_.data();
+#endif
+  size_ = size;
+}
+
+void TestCorpus::Unmap() {
+#ifdef __unix__
+  if (data_) {
+    munmap(const_cast<char*>(data_), size_);
+  }
+#endif
+  data_ = nullptr;
+  size_ = 0;
+}
+
+size_t TestCorpus::Index(size_t offset) {
+  while (offset + sizeof(RecordHeader) <= size_) {
+    RecordHeader header;
+    std::memcpy(&header, data_ + offset, sizeof(header));
+    auto end = offset + 8 + header.payload_size;
+    if (std::memcmp(header.tag, "MTRX", 4) != 0 || end > size_) {
+      break;
+    }
+    CorpusKey key{"", "", header.size, header.seed, header.min, header.max};
+    auto pos = offset + sizeof(header);
+    if (!ReadString(data_, &pos, end, &key.generator) ||
+        !ReadString(data_, &pos, end, &key.check) ||
+        pos + sizeof(double) * header.size * header.size != end) {
+      break;
+    }
+    offsets_.emplace(ToKey(key), offset);
+    offset = end;
+  }
+  return offset;
+}
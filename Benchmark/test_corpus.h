@@ -0,0 +1,81 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "Matrix/matrix.h"
+
+// A generated test matrix is identified by its generator and parameters;
+// check names the solver run that validated it, since the same matrix may
+// converge under one check and not under another.
+struct CorpusKey {
+  std::string generator;
+  std::string check;
+  int size;
+  int seed;
+  double min;
+  double max;
+};
+
+// Result of the check: iterations, negative when it did not converge, and
+// the time it took in seconds.
+struct CorpusOutcome {
+  int iters = -1;
+  double time = 0;
+};
+
+struct CorpusEntry {
+  DMatrix matrix;
+  CorpusOutcome outcome;
+};
+
+// Generated and validated test matrices kept between phases and runs. The
+// file is append-only and memory-mapped for reading; every record is
+//   "MTRX", uint32 payload size,
+//   int32 size, int32 seed, double min, double max,
+//   int32 iters, int32 0, double time, generator, check,
+//   double entries[size * size] row by row
+// with strings as a uint32 length and the bytes padded to 8, so the entries
+// are 8 byte aligned in the mapping. A record torn by a crash is cut off
+// when the file is opened. Several threads and processes may add at once:
+// appends and the cut take an flock on the file, so a record still being
+// appended is never taken for a torn one.
+class TestCorpus {
+ public:
+  explicit TestCorpus(std::string path);
+  ~TestCorpus();
+
+  TestCorpus(const TestCorpus&) = delete;
+  TestCorpus& operator=(const TestCorpus&) = delete;
+
+  std::optional<CorpusEntry> Find(const CorpusKey& key) const;
+  void Add(const CorpusKey& key, const CorpusEntry& entry);
+  // The stored entry, or a new one from generate and check that gets stored.
+  CorpusEntry GetOrCreate(
+      const CorpusKey& key,
+      const std::function<DMatrix()>& generate,
+      const std::function<CorpusOutcome(const DMatrix&)>& check);
+
+  size_t Size() const;
+
+ private:
+  using Key = std::tuple<std::string, std::string, int, int, double, double>;
+
+  static Key ToKey(const CorpusKey& key);
+  void Map();
+  void Unmap();
+  // Indexes the complete records from offset on, returns where they end.
+  size_t Index(size_t offset);
+
+  std::string path_;
+  mutable std::mutex mutex_;
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+  size_t indexed_ = 0;
+  std::vector<char> buffer_;
+  std::map<Key, size_t> offsets_;
+};
@@ -0,0 +1,241 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <complex>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "matrix.h"
+
+// Random matrices from a counter-based generator: entry (i, j) of matrix
+// number index is a pure function of (seed, index, i, j). Unlike
+// Matrix::Random the result does not depend on which thread generates what
+// or in which order, so matrices can be filled in parallel and any single
+// one can be regenerated from its number alone.
+
+namespace __internal {
+
+// Philox4x32-10 from Salmon et al., "Parallel random numbers: as easy as
+// 1, 2, 3". No branches and only 32x32 -> 64 bit multiplications, so loops
+// over independent counters vectorize.
+inline std::array<uint32_t, 4> Philox4x32(std::array<uint32_t, 4> counter,
+                                          std::array<uint32_t, 2> key) {
+  for (int round = 0; round < 10; round++) {
+    uint64_t p0 = uint64_t{0xD2511F53} * counter[0];
+    uint64_t p1 = uint64_t{0xCD9E8D57} * counter[2];
+    counter = {static_cast<uint32_t>(p1 >> 32) ^ counter[1] ^ key[0],
+               static_cast<uint32_t>(p1),
+               static_cast<uint32_t>(p0 >> 32) ^ counter[3] ^ key[1],
+               static_cast<uint32_t>(p0)};
+    key[0] += 0x9E3779B9;
+    key[1] += 0xBB67AE85;
+  }
+  return counter;
+}
+
+// One Philox block gives the entries (i, j) and (i, j + 1) for even j.
+inline std::array<double, 2> UniformPair(uint64_t seed,
+                                         uint64_t index,
+                                         int i,
+                                         int j) {
+  auto r = Philox4x32({static_cast<uint32_t>(j / 2),
+                       static_cast<uint32_t>(i),
+                       static_cast<uint32_t>(index),
+                       static_cast<uint32_t>(index >> 32)},
+                      {static_cast<uint32_t>(seed),
+                       static_cast<uint32_t>(seed >> 32)});
+  // 53 random bits each, scaled into [0, 1).
+  return {static_cast<double>(((uint64_t{r[0]} << 32) | r[1]) >> 11) * 0x1p-53,
+          static_cast<double>(((uint64_t{r[2]} << 32) | r[3]) >> 11) * 0x1p-53};
+}
+
+// Uniform in [0, 1) for entry (i, j) of matrix index.
+inline double Uniform(uint64_t seed, uint64_t index, int i, int j) {
+  return UniformPair(seed, index, i, j & ~1)[j & 1];
+}
+
+// Calls fill(i) for every row on thread_num threads, rows split in blocks.
+template<class F>
+void ForEachRow(int n, int thread_num, const F& fill) {
+  thread_num = std::max(1, std::min(thread_num, n));
+  if (thread_num == 1) {
+    for (int i = 0; i < n; i++) {
+      fill(i);
+    }
+    return;
+  }
+  std::vector<std::thread> threads;
+  threads.reserve(thread_num);
+  for (int t = 0; t < thread_num; t++) {
+    threads.emplace_back([&, t]() {
+      for (int i = n * t / thread_num; i < n * (t + 1) / thread_num; i++) {
+        fill(i);
+      }
+    });
+  }
+  for (auto& thread: threads) {
+    thread.join();
+  }
+}
+
+// Fills columns [from, to) of row i with f(u), u uniform in [0, 1). The
+// uniforms go through a row buffer so the generator loop has no stores into
+// the matrix and stays vectorizable.
+template<class T, class F>
+void FillRow(Matrix<T>& a, uint64_t seed, uint64_t index, int i,
+             int from, int to, const F& f) {
+  if (from >= to) {
+    return;
+  }
+  int first = from & ~1;
+  std::vector<double> row(to - first + 1);
+  for (int j = first; j < to; j += 2) {
+    auto pair = UniformPair(seed, index, i, j);
+    row[j - first] = pair[0];
+    row[j - first + 1] = pair[1];
+  }
+  for (int j = from; j < to; j++) {
+    a(i, j) = f(row[j - first]);
+  }
+}
+
+}
+
+// Entries uniform in [min, max).
+template<class T>
+Matrix<T> CounterRandomMatrix(int n, int m, T min, T max,
+                              uint64_t seed, uint64_t index = 0,
+                              int thread_num = 1) {
+  Matrix<T> a(n, m);
+  __internal::ForEachRow(n, thread_num, [&](int i) {
+    __internal::FillRow(a, seed, index, i, 0, m, [&](double u) {
+      return static_cast<T>(min + (max - min) * u);
+    });
+  });
+  return a;
+}
+
+// Integer entries uniform in [min, max].
+template<class T>
+Matrix<T> CounterRandomInts(int n, int m, int min, int max,
+                            uint64_t seed, uint64_t index = 0,
+                            int thread_num = 1) {
+  if (min > max) {
+    throw std::invalid_argument("Empty range of random integers");
+  }
+  Matrix<T> a(n, m);
+  double range = static_cast<double>(max) - min + 1;
+  __internal::ForEachRow(n, thread_num, [&](int i) {
+    __internal::FillRow(a, seed, index, i, 0, m, [&](double u) {
+      return static_cast<T>(min + static_cast<int64_t>(u * range));
+    });
+  });
+  return a;
+}
+
+// Symmetric with the upper triangle uniform in [min, max).
+template<class T>
+Matrix<T> CounterRandomSymmetric(int n, T min, T max,
+                                 uint64_t seed, uint64_t index = 0,
+                                 int thread_num = 1) {
+  Matrix<T> a(n, n);
+  __internal::ForEachRow(n, thread_num, [&](int i) {
+    __internal::FillRow(a, seed, index, i, i, n, [&](double u) {
+      return static_cast<T>(min + (max - min) * u);
+    });
+  });
+  for (int i = 0; i < n; i++) {
+    for (int j = 0; j < i; j++) {
+      a(i, j) = a(j, i);
+    }
+  }
+  return a;
+}
+
+// Nonzero only for -lower <= j - i <= upper, there uniform in [min, max).
+template<class T>
+Matrix<T> CounterRandomBanded(int n, int lower, int upper, T min, T max,
+                              uint64_t seed, uint64_t index = 0,
+                              int thread_num = 1) {
+  if (lower < 0 || upper < 0) {
+    throw std::invalid_argument("Band widths should be non-negative");
+  }
+  Matrix<T> a(n, n);
+  __internal::ForEachRow(n, thread_num, [&](int i) {
+    __internal::FillRow(a, seed, index, i, std::max(0, i - lower),
+                        std::min(n, i + upper + 1), [&](double u) {
+      return static_cast<T>(min + (max - min) * u);
+    });
+  });
+  return a;
+}
+
+// Q * D * Q^T with Q a random orthogonal matrix, a product of n Householder
+// reflections, and D block diagonal with the given eigenvalues: real ones on
+// the diagonal and every complex pair x +- iy, listed next to each other, as
+// a block {{x, y}, {-y, x}}. With real eigenvalues only the result is
+// symmetric.
+template<class T>
+Matrix<T> CounterRandomWithSpectrum(
+    const std::vector<std::complex<T>>& eigenvalues,
+    uint64_t seed, uint64_t index = 0) {
+  int n = eigenvalues.size();
+  Matrix<T> a(n, n);
+  for (int i = 0; i < n; i++) {
+    auto e = eigenvalues[i];
+    if (e.imag() == 0) {
+      a(i, i) = e.real();
+      continue;
+    }
+    if (i + 1 == n || eigenvalues[i + 1] != std::conj(e)) {
+      throw std::invalid_argument(
+          "Complex eigenvalues should come in adjacent conjugate pairs");
+    }
+    a(i, i) = a(i + 1, i + 1) = e.real();
+    a(i, i + 1) = e.imag();
+    a(i + 1, i) = -e.imag();
+    i++;
+  }
+  // a = H a H with H = I - 2 v v^T / (v^T v) for random v. The vectors are
+  // taken from rows n and up of the counter space.
+  std::vector<T> v(n);
+  std::vector<T> w(n);
+  for (int k = 0; k < n; k++) {
+    T norm = 0;
+    for (int i = 0; i < n; i++) {
+      v[i] = 2 * __internal::Uniform(seed, index, n + k, i) - 1;
+      norm += v[i] * v[i];
+    }
+    if (norm == 0) {
+      continue;
+    }
+    // H a: a -= v (2 v^T a / norm)
+    for (int j = 0; j < n; j++) {
+      w[j] = 0;
+    }
+    for (int i = 0; i < n; i++) {
+      for (int j = 0; j < n; j++) {
+        w[j] += v[i] * a(i, j);
+      }
+    }
+    for (int i = 0; i < n; i++) {
+      for (int j = 0; j < n; j++) {
+        a(i, j) -= 2 * v[i] * w[j] / norm;
+      }
+    }
+    // (H a) H: a -= (2 a v / norm) v^T
+    for (int i = 0; i < n; i++) {
+      T s = 0;
+      for (int j = 0; j < n; j++) {
+        s += a(i, j) * v[j];
+      }
+      for (int j = 0; j < n; j++) {
+        a(i, j) -= 2 * s * v[j] / norm;
+      }
+    }
+  }
+  COUNT_WORK(8 * uint64_t(n) * n * n, 4 * uint64_t(n) * n * n * sizeof(T));
+  return a;
+}
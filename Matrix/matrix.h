@@ -5,6 +5,9 @@
 #include <sstream>
 #include <iomanip>
 #include <complex>
+#include <vector>
+#include "matrix_format.h"
+#include "work_counter.h"
 
 template<class T, class U>
 void AssertEqualSizes(const T& a, const U& b);
@@ -41,6 +44,8 @@ class Matrix {
 
   int Rows() const;
   int Cols() const;
+  // Distance between the starts of two neighbouring rows in the storage.
+  int RowStride() const;
 
   Matrix<T> Transposed();
 
@@ -49,7 +54,11 @@ class Matrix {
   static Matrix<T> Random(int n, int m, T min, T max, int seed = time(nullptr),
                           bool force_seed = false);
   static Matrix<T> RandomInts(int n, int m, int min, int max,
-                              int seed = time(nullptr));
+                              int seed = time(nullptr),
+                              bool force_seed = false);
+  // Wraps row-major n x m storage without copying it. The matrix and its
+  // views keep the storage alive; its deleter decides how it is released.
+  static Matrix<T> FromStorage(std::shared_ptr<T[]> data, int n, int m);
 
   std::string ToWolframString() const;
 
@@ -75,6 +84,9 @@ class Matrix {
   // const Matrix<T> Col(int j) const;
   Matrix<T> Col(int j);
 
+  void SwapRows(int i, int j);
+  void SwapCols(int i, int j);
+
   Matrix<T>& operator=(const Matrix<T>& b);
   Matrix<T>& operator=(Matrix<T>&& b) noexcept;
 
@@ -256,9 +268,22 @@ Matrix<T> Matrix<T>::Random(int n, int m, T min, T max, int seed,
 }
 
 template<class T>
-Matrix<T> Matrix<T>::RandomInts(int n, int m, int min, int max, int seed) {
+Matrix<T> Matrix<T>::FromStorage(std::shared_ptr<T[]> data, int n, int m) {
+  Matrix<T> a;
+  a.data_ = std::move(data);
+  a.data_rows_ = a.rows_ = n;
+  a.data_cols_ = a.cols_ = m;
+  return a;
+}
+
+template<class T>
+Matrix<T> Matrix<T>::RandomInts(int n, int m, int min, int max, int seed,
+                                bool force_seed) {
   Matrix<T> a(n, m);
   thread_local static std::mt19937 gen(seed);
+  if (force_seed) {
+    gen.seed(seed);
+  }
   std::uniform_int_distribution<int> dist(min, max);
   for (int i = 0; i < n; i++) {
     for (int j = 0; j < m; j++) {
@@ -270,25 +295,23 @@ Matrix<T> Matrix<T>::RandomInts(int n, int m, int min, int max, int seed) {
 
 template<class T>
 std::string Matrix<T>::ToWolframString() const {
-  std::stringstream res;
+  std::string res = "{";
   auto precision = Matrix<T>::GetPrecision();
-  res << "{";
   for (int i = 0; i < this->Rows(); i++) {
-    res << "{";
+    res += '{';
     for (int j = 0; j < this->Cols(); j++) {
-      res << std::fixed << std::setprecision(precision)
-          << this->At(i, j);
+      __internal::AppendEntry(res, this->At(i, j), precision);
       if (j + 1 != this->Cols()) {
-        res << ",";
+        res += ',';
       }
     }
-    res << "}";
+    res += '}';
     if (i + 1 != this->Rows()) {
-      res << ",";
+      res += ',';
     }
   }
-  res << "}\n";
-  return res.str();
+  res += "}\n";
+  return res;
 }
 
 template<class T>
@@ -355,9 +378,31 @@ Matrix<T> Matrix<T>::Col(int j) {
   return this->SubMatrix(0, j, this->Rows(), 1);
 }
 
+template<class T>
+void Matrix<T>::SwapRows(int i, int j) {
+  if (i == j) {
+    return;
+  }
+  for (int k = 0; k < this->Cols(); k++) {
+    std::swap(this->At(i, k), this->At(j, k));
+  }
+}
+
+template<class T>
+void Matrix<T>::SwapCols(int i, int j) {
+  if (i == j) {
+    return;
+  }
+  for (int k = 0; k < this->Rows(); k++) {
+    std::swap(this->At(k, i), this->At(k, j));
+  }
+}
+
 template<class T>
 Matrix<T>& Matrix<T>::operator+=(const Matrix<T>& a) {
   AssertEqualSizes(*this, a);
+  COUNT_WORK(__internal::Flops<T>::kAdd * a.Rows() * a.Cols(),
+             3 * sizeof(T) * a.Rows() * a.Cols());
   for (int i = 0; i < a.Rows(); ++i) {
     for (int j = 0; j < a.Cols(); ++j) {
       this->At(i, j) += a.At(i, j);
@@ -369,6 +414,8 @@ Matrix<T>& Matrix<T>::operator+=(const Matrix<T>& a) {
 template<class T>
 Matrix<T>& Matrix<T>::operator-=(const Matrix<T>& a) {
   AssertEqualSizes(*this, a);
+  COUNT_WORK(__internal::Flops<T>::kAdd * a.Rows() * a.Cols(),
+             3 * sizeof(T) * a.Rows() * a.Cols());
   for (int i = 0; i < a.Rows(); ++i) {
     for (int j = 0; j < a.Cols(); ++j) {
       this->At(i, j) -= a.At(i, j);
@@ -386,6 +433,8 @@ Matrix<T>& Matrix<T>::operator*=(const Matrix<T>& a) {
 template<class T>
 template<class U>
 Matrix<T>& Matrix<T>::operator*=(U b) {
+  COUNT_WORK(__internal::Flops<T>::kMultiply * this->Rows() * this->Cols(),
+             2 * sizeof(T) * this->Rows() * this->Cols());
   for (int i = 0; i < this->Rows(); ++i) {
     for (int j = 0; j < this->Cols(); ++j) {
       this->At(i, j) *= b;
@@ -397,6 +446,8 @@ Matrix<T>& Matrix<T>::operator*=(U b) {
 template<class T>
 template<class U>
 Matrix<T>& Matrix<T>::operator/=(U b) {
+  COUNT_WORK(__internal::Flops<T>::kMultiply * this->Rows() * this->Cols(),
+             2 * sizeof(T) * this->Rows() * this->Cols());
   for (int i = 0; i < this->Rows(); ++i) {
     for (int j = 0; j < this->Cols(); ++j) {
       this->At(i, j) /= b;
@@ -405,6 +456,11 @@ Matrix<T>& Matrix<T>::operator/=(U b) {
   return *this;
 }
 
+template<class T>
+int Matrix<T>::RowStride() const {
+  return data_cols_;
+}
+
 template<class T>
 bool Matrix<T>::IsSubMatrix() const {
   return !(cols_ == data_cols_
@@ -484,21 +540,42 @@ Matrix<T> operator-(const Matrix<T>& a, const Matrix<T>& b) {
   return res;
 }
 
+// lhs * rhs into result, which has to be of the size of the product and
+// apart from both; nothing is allocated.
 template<class T>
-Matrix<T> operator*(const Matrix<T>& lhs, const Matrix<T>& rhs) {
-  if (lhs.Cols() != rhs.Rows()) {
+void MultiplyInto(const Matrix<T>& lhs, const Matrix<T>& rhs,
+                  Matrix<T>& result) {
+  if (lhs.Cols() != rhs.Rows() ||
+      result.Size() != std::make_pair(lhs.Rows(), rhs.Cols())) {
     throw std::runtime_error(
         "Bad matrix sizes " + PairToString(lhs.Size()) + " "
-            + PairToString(rhs.Size()));
+            + PairToString(rhs.Size()) + " " + PairToString(result.Size()));
   }
-  Matrix<T> result(lhs.Rows(), rhs.Cols());
+  COUNT_WORK(__internal::Flops<T>::kMultiplyAdd *
+                 lhs.Rows() * lhs.Cols() * rhs.Cols(),
+             sizeof(T) * (lhs.Rows() * lhs.Cols() + rhs.Rows() * rhs.Cols() +
+                 result.Rows() * result.Cols()));
   for (int i = 0; i < lhs.Rows(); i++) {
+    for (int j = 0; j < rhs.Cols(); j++) {
+      result.At(i, j) = T();
+    }
     for (int k = 0; k < lhs.Cols(); k++) {
       for (int j = 0; j < rhs.Cols(); j++) {
         result.At(i, j) += lhs.At(i, k) * rhs.At(k, j);
       }
     }
   }
+}
+
+template<class T>
+Matrix<T> operator*(const Matrix<T>& lhs, const Matrix<T>& rhs) {
+  if (lhs.Cols() != rhs.Rows()) {
+    throw std::runtime_error(
+        "Bad matrix sizes " + PairToString(lhs.Size()) + " "
+            + PairToString(rhs.Size()));
+  }
+  Matrix<T> result(lhs.Rows(), rhs.Cols());
+  MultiplyInto(lhs, rhs, result);
   return result;
 }
 
@@ -523,6 +600,8 @@ T Matrix<T>::ScalarProduct(const Matrix<T>& b) const {
         " and " + PairToString(b.Size()) + " are not both vectors");
   }
   AssertEqualSizes(*this, b);
+  COUNT_WORK(__internal::Flops<T>::kMultiplyAdd * std::max(b.Rows(), b.Cols()),
+             2 * sizeof(T) * std::max(b.Rows(), b.Cols()));
   T ans = T();
   for (int i = 0; i < std::max(this->Cols(), this->Rows()); i++) {
     ans += this->At(i) * b.At(i);
@@ -628,35 +707,52 @@ void AssertEqualSizes(const T& a, const U& b) {
   }
 }
 
+// Every entry is formatted once, into one buffer, and the widest gives the
+// column width. The output goes to the stream in blocks. The stream is left
+// in std::fixed with the matrix precision, as callers printing numbers after
+// a matrix expect.
 template<class U>
 std::ostream& operator<<(std::ostream& stream,
                          const Matrix<U>& matrix) {
-  size_t maxlen = 0;
+  constexpr size_t kBlock = 1 << 16;
   auto precision = Matrix<U>::GetPrecision();
-  for (size_t i = 0; i < matrix.Rows(); i++) {
-    for (size_t j = 0; j < matrix.Cols(); j++) {
-      std::stringstream ss;
-      ss << std::fixed << std::setprecision(precision) << matrix.At(i, j);
-      maxlen = std::max(maxlen, ss.str().length());
+  std::string entries;
+  std::vector<size_t> ends;
+  ends.reserve(size_t(matrix.Rows()) * matrix.Cols());
+  size_t maxlen = 0;
+  for (int i = 0; i < matrix.Rows(); i++) {
+    for (int j = 0; j < matrix.Cols(); j++) {
+      size_t begin = entries.size();
+      __internal::AppendEntry(entries, matrix.At(i, j), precision);
+      maxlen = std::max(maxlen, entries.size() - begin);
+      ends.push_back(entries.size());
     }
   }
-  stream << "[";
-  for (size_t i = 0; i < matrix.Rows(); i++) {
+  stream << std::fixed << std::setprecision(precision);
+  std::string out = "[";
+  size_t k = 0;
+  for (int i = 0; i < matrix.Rows(); i++) {
     if (i != 0) {
-      stream << ' ';
+      out += ' ';
     }
-    for (size_t j = 0; j < matrix.Cols(); j++) {
-      stream << std::fixed << std::setprecision(precision) << std::setw(maxlen)
-             << matrix.At(i, j);
+    for (int j = 0; j < matrix.Cols(); j++, k++) {
+      size_t begin = k == 0 ? 0 : ends[k - 1];
+      out.append(maxlen - (ends[k] - begin), ' ');
+      out.append(entries, begin, ends[k] - begin);
       if (i + 1 < matrix.Rows() || j + 1 < matrix.Cols()) {
-        stream << ", ";
+        out += ", ";
       }
     }
     if (i + 1 < matrix.Rows()) {
-      stream << '\n';
+      out += '\n';
+    }
+    if (out.size() >= kBlock) {
+      stream.write(out.data(), out.size());
+      out.clear();
     }
   }
-  stream << "]\n";
+  out += "]\n";
+  stream.write(out.data(), out.size());
   return stream;
 }
 
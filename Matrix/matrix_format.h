@@ -0,0 +1,101 @@
+#pragma once
+
+#include <charconv>
+#include <complex>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <type_traits>
+
+// Text of matrix entries built with std::to_chars: no stream, locale or
+// temporary string per entry. Entries come out exactly as a stream in
+// std::fixed with the same precision prints them; types to_chars doesn't
+// know go through a stream.
+
+namespace __internal {
+
+template<class T>
+constexpr bool kHasToChars =
+    std::is_floating_point_v<T> ||
+    (std::is_integral_v<T> && !std::is_same_v<T, bool> &&
+     !std::is_same_v<T, char> && !std::is_same_v<T, signed char> &&
+     !std::is_same_v<T, unsigned char> && !std::is_same_v<T, wchar_t> &&
+     !std::is_same_v<T, char8_t> && !std::is_same_v<T, char16_t> &&
+     !std::is_same_v<T, char32_t>);
+
+template<class T>
+struct IsComplexNumber : std::false_type {};
+
+template<class T>
+struct IsComplexNumber<std::complex<T>> : std::true_type {};
+
+// Real type of the parts of T.
+template<class T>
+struct ScalarOf {
+  using Type = T;
+};
+
+template<class T>
+struct ScalarOf<std::complex<T>> {
+  using Type = T;
+};
+
+// In fixed notation with precision digits after the point, shortest
+// round trip notation when precision is negative.
+template<class T>
+std::to_chars_result NumberToChars(char* first, char* last, T value,
+                                   int precision) {
+  if constexpr (std::is_floating_point_v<T>) {
+    if (precision >= 0) {
+      return std::to_chars(first, last, value, std::chars_format::fixed,
+                           precision);
+    }
+  }
+  return std::to_chars(first, last, value);
+}
+
+template<class T>
+void AppendNumber(std::string& out, T value, int precision) {
+  char buffer[128];
+  auto result = NumberToChars(buffer, buffer + sizeof(buffer), value,
+                              precision);
+  if (result.ec == std::errc()) {
+    out.append(buffer, result.ptr);
+    return;
+  }
+  // Huge values in fixed notation, up to max_exponent10 digits before the
+  // point.
+  std::string large(std::numeric_limits<T>::max_exponent10 +
+                    std::max(precision, 0) + 8, '\0');
+  result = NumberToChars(large.data(), large.data() + large.size(), value,
+                         precision);
+  out.append(large.data(), result.ptr);
+}
+
+// Appends value as stream << std::fixed << std::setprecision(precision)
+// prints it.
+template<class T>
+void AppendEntry(std::string& out, const T& value, int precision) {
+  if constexpr (kHasToChars<T>) {
+    AppendNumber(out, value, precision);
+  } else if constexpr (IsComplexNumber<T>::value) {
+    if constexpr (kHasToChars<typename T::value_type>) {
+      out += '(';
+      AppendNumber(out, value.real(), precision);
+      out += ',';
+      AppendNumber(out, value.imag(), precision);
+      out += ')';
+    } else {
+      std::ostringstream ss;
+      ss << std::fixed << std::setprecision(precision) << value;
+      out += ss.str();
+    }
+  } else {
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(precision) << value;
+    out += ss.str();
+  }
+}
+
+}
@@ -0,0 +1,240 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <complex>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include "matrix.h"
+
+#ifdef __unix__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Binary matrix files: a 64 byte header, then the entries row by row with
+// every scalar little-endian. The header is "LAMATRIX", uint32 version,
+// uint32 scalar type, uint32 entry size, uint32 0, uint64 rows, uint64 cols,
+// uint64 offset of the entries and zero padding. The entries start 64 byte
+// aligned, so a mapped file serves as Matrix storage as it is.
+
+namespace __internal {
+
+template<class T>
+struct MatrixFileType;
+
+template<>
+struct MatrixFileType<float> {
+  static constexpr uint32_t kCode = 1;
+};
+
+template<>
+struct MatrixFileType<double> {
+  static constexpr uint32_t kCode = 2;
+};
+
+template<>
+struct MatrixFileType<std::complex<float>> {
+  static constexpr uint32_t kCode = 3;
+};
+
+template<>
+struct MatrixFileType<std::complex<double>> {
+  static constexpr uint32_t kCode = 4;
+};
+
+struct MatrixFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t type;
+  uint32_t entry_size;
+  uint32_t reserved;
+  uint64_t rows;
+  uint64_t cols;
+  uint64_t data_offset;
+  char padding[16];
+};
+
+static_assert(sizeof(MatrixFileHeader) == 64);
+
+// Files are read and written in chunks of whole rows of about this size.
+constexpr size_t kMatrixFileChunk = 1 << 22;
+
+// Converts count entries between host and file byte order, both ways.
+template<class T>
+void SwapToLittleEndian(T* data, size_t count) {
+  if constexpr (std::endian::native != std::endian::little) {
+    using Scalar = typename ScalarOf<T>::Type;
+    auto bytes = reinterpret_cast<char*>(data);
+    for (size_t i = 0; i < count * sizeof(T); i += sizeof(Scalar)) {
+      std::reverse(bytes + i, bytes + i + sizeof(Scalar));
+    }
+  }
+}
+
+template<class T>
+MatrixFileHeader ReadMatrixHeader(std::istream& in) {
+  MatrixFileHeader header;
+  in.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (!in || std::memcmp(header.magic, "LAMATRIX", 8) != 0) {
+    throw std::runtime_error("Not a matrix file");
+  }
+  SwapToLittleEndian(&header.version, 1);
+  SwapToLittleEndian(&header.type, 1);
+  SwapToLittleEndian(&header.entry_size, 1);
+  SwapToLittleEndian(&header.rows, 1);
+  SwapToLittleEndian(&header.cols, 1);
+  SwapToLittleEndian(&header.data_offset, 1);
+  if (header.version != 1 || header.type != MatrixFileType<T>::kCode ||
+      header.entry_size != sizeof(T) ||
+      header.data_offset < sizeof(header) ||
+      header.data_offset % alignof(T) != 0) {
+    throw std::runtime_error("Matrix file of another type or version");
+  }
+  constexpr uint64_t kMaxEntries = std::numeric_limits<int>::max();
+  if (header.rows > kMaxEntries || header.cols > kMaxEntries ||
+      header.rows * header.cols > kMaxEntries) {
+    throw std::runtime_error(
+        "Matrix of size " + PairToString(std::make_pair(header.rows,
+                                                        header.cols)) +
+        " is too large");
+  }
+  return header;
+}
+
+template<class T>
+int RowsPerChunk(int cols) {
+  return std::max<size_t>(1, kMatrixFileChunk / std::max<size_t>(
+      1, cols * sizeof(T)));
+}
+
+}
+
+template<class T>
+void WriteMatrix(std::ostream& out, const Matrix<T>& a) {
+  __internal::MatrixFileHeader header{{'L', 'A', 'M', 'A', 'T', 'R', 'I', 'X'},
+                                      1, __internal::MatrixFileType<T>::kCode,
+                                      sizeof(T), 0,
+                                      static_cast<uint64_t>(a.Rows()),
+                                      static_cast<uint64_t>(a.Cols()),
+                                      sizeof(header), {}};
+  __internal::SwapToLittleEndian(&header.version, 1);
+  __internal::SwapToLittleEndian(&header.type, 1);
+  __internal::SwapToLittleEndian(&header.entry_size, 1);
+  __internal::SwapToLittleEndian(&header.rows, 1);
+  __internal::SwapToLittleEndian(&header.cols, 1);
+  __internal::SwapToLittleEndian(&header.data_offset, 1);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  // Rows are contiguous in views too, so chunks are gathered row by row.
+  int rows_per_chunk = __internal::RowsPerChunk<T>(a.Cols());
+  std::vector<T> chunk;
+  for (int i = 0; i < a.Rows() && a.Cols() > 0; i += rows_per_chunk) {
+    chunk.clear();
+    for (int k = i; k < std::min(a.Rows(), i + rows_per_chunk); k++) {
+      chunk.insert(chunk.end(), &a.At(k, 0), &a.At(k, 0) + a.Cols());
+    }
+    __internal::SwapToLittleEndian(chunk.data(), chunk.size());
+    out.write(reinterpret_cast<const char*>(chunk.data()),
+              chunk.size() * sizeof(T));
+  }
+  if (!out) {
+    throw std::runtime_error("Can't write matrix");
+  }
+}
+
+template<class T>
+void WriteMatrix(const std::string& path, const Matrix<T>& a) {
+  std::ofstream out(path, std::ios::binary);
+  if (!out.is_open()) {
+    throw std::runtime_error("Can't open " + path);
+  }
+  WriteMatrix(out, a);
+}
+
+template<class T>
+Matrix<T> ReadMatrix(std::istream& in) {
+  auto header = __internal::ReadMatrixHeader<T>(in);
+  in.ignore(header.data_offset - sizeof(header));
+  Matrix<T> a(header.rows, header.cols);
+  int rows_per_chunk = __internal::RowsPerChunk<T>(a.Cols());
+  for (int i = 0; i < a.Rows() && a.Cols() > 0; i += rows_per_chunk) {
+    size_t count = size_t(std::min(rows_per_chunk, a.Rows() - i)) * a.Cols();
+    in.read(reinterpret_cast<char*>(&a(i, 0)), count * sizeof(T));
+    __internal::SwapToLittleEndian(&a(i, 0), count);
+  }
+  if (!in) {
+    throw std::runtime_error("Truncated matrix file");
+  }
+  return a;
+}
+
+template<class T>
+Matrix<T> ReadMatrix(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in.is_open()) {
+    throw std::runtime_error("Can't open " + path);
+  }
+  return ReadMatrix<T>(in);
+}
+
+enum class MatrixMapping {
+  kReadOnly,     // Writing into the matrix crashes
+  kCopyOnWrite,  // Written pages become private, the file never changes
+};
+
+// Matrix stored in a mapping of the file: nothing is read up front, pages
+// are loaded as they are touched and the mapping lives as long as the matrix
+// or any view of it. Solvers taking their matrix by value copy it, unless
+// it is moved in. Where mmap is unavailable or the host is big-endian this
+// is ReadMatrix.
+template<class T>
+Matrix<T> MapMatrix(const std::string& path,
+                    MatrixMapping mapping = MatrixMapping::kCopyOnWrite) {
+#ifdef __unix__
+  if constexpr (std::endian::native == std::endian::little) {
+    __internal::MatrixFileHeader header;
+    {
+      std::ifstream in(path, std::ios::binary);
+      if (!in.is_open()) {
+        throw std::runtime_error("Can't open " + path);
+      }
+      header = __internal::ReadMatrixHeader<T>(in);
+    }
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat file;
+    if (fd < 0 || fstat(fd, &file) != 0) {
+      if (fd >= 0) {
+        close(fd);
+      }
+      throw std::runtime_error("Can't open " + path);
+    }
+    size_t size = header.data_offset + header.rows * header.cols * sizeof(T);
+    if (file.st_size < size) {
+      close(fd);
+      throw std::runtime_error("Truncated matrix file");
+    }
+    int protection = mapping == MatrixMapping::kReadOnly
+                     ? PROT_READ : PROT_READ | PROT_WRITE;
+    void* base = mmap(nullptr, size, protection, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+      throw std::runtime_error("Can't map " + path);
+    }
+    std::shared_ptr<T[]> data(
+        reinterpret_cast<T*>(static_cast<char*>(base) + header.data_offset),
+        [base, size](T*) {
+          munmap(base, size);
+        });
+    return Matrix<T>::FromStorage(std::move(data), header.rows, header.cols);
+  }
+#endif
+  return ReadMatrix<T>(path);
+}
@@ -0,0 +1,667 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <complex>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "matrix.h"
+#include "matrix_format.h"
+#include "matrix_io.h"
+
+#ifdef __unix__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Readers for Matrix Market files (array and coordinate, any field and
+// symmetry), and a reader and a writer for plain text dumps with one matrix
+// row per line. The
+// file is mapped and split into chunks at line ends, and each chunk is
+// parsed on its own thread with std::from_chars straight into the matrix.
+// Coordinate files fill a dense matrix, zero where no entry is given.
+// Complex entries are two numbers, the real part and then the imaginary one.
+
+namespace __internal {
+
+// The whole file as one range of characters: mapped where mmap is
+// available, read into memory otherwise.
+class TextFile {
+ public:
+  explicit TextFile(const std::string& path) {
+#ifdef __unix__
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat file;
+    if (fd < 0 || fstat(fd, &file) != 0) {
+      if (fd >= 0) {
+        close(fd);
+      }
+      throw std::runtime_error("Can't open " + path);
+    }
+    size_ = file.st_size;
+    if (size_ > 0) {
+      map_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (map_ == MAP_FAILED) {
+      throw std::runtime_error("Can't map " + path);
+    }
+    if (map_ != nullptr) {
+      madvise(map_, size_, MADV_SEQUENTIAL);
+    }
+    data_ = static_cast<const char*>(map_);
+#else
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+      throw std::runtime_error("Can't open " + path);
+    }
+    std::stringstream ss;
+    ss << in.rdbuf();
+    buffer_ = ss.str();
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+#endif
+  }
+
+  TextFile(const TextFile&) = delete;
+  TextFile& operator=(const TextFile&) = delete;
+
+  ~TextFile() {
+#ifdef __unix__
+    if (map_ != nullptr) {
+      munmap(map_, size_);
+    }
+#endif
+  }
+
+  std::string_view View() const {
+    return {data_, size_};
+  }
+
+ private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+  void* map_ = nullptr;
+  std::string buffer_;
+};
+
+template<class T>
+constexpr bool kIsComplex = !std::is_same_v<T, typename ScalarOf<T>::Type>;
+
+inline bool IsBlank(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Splits text into up to parts ranges, every one but the last ending right
+// after a line end. Returns the parts + 1 bounds.
+inline std::vector<size_t> SplitAtLines(std::string_view text, int parts) {
+  std::vector<size_t> bounds{0};
+  for (int k = 1; k < parts; k++) {
+    size_t pos = std::max(bounds.back(), text.size() * k / parts);
+    pos = text.find('\n', pos);
+    if (pos == std::string_view::npos) {
+      break;
+    }
+    bounds.push_back(pos + 1);
+  }
+  bounds.push_back(text.size());
+  return bounds;
+}
+
+// Calls number(value) for every number in [begin, end) and line() after
+// every line end, numbers are separated by blanks.
+template<class Number, class Line>
+void ScanNumbers(const char* begin, const char* end,
+                 const Number& number, const Line& line) {
+  const char* p = begin;
+  while (p < end) {
+    if (IsBlank(*p)) {
+      p++;
+      continue;
+    }
+    if (*p == '\n') {
+      line();
+      p++;
+      continue;
+    }
+    double value;
+    // from_chars takes no leading plus.
+    const char* first = *p == '+' ? p + 1 : p;
+    auto [ptr, ec] = std::from_chars(first, end, value);
+    if (ec != std::errc() || (ptr < end && !IsBlank(*ptr) && *ptr != '\n')) {
+      const char* bad_end = std::find_if(p, std::min(end, p + 32), [](char c) {
+        return IsBlank(c) || c == '\n';
+      });
+      throw std::runtime_error("Can't parse number '" +
+                               std::string(p, bad_end) + "'");
+    }
+    number(value);
+    p = ptr;
+  }
+}
+
+inline size_t CountNumbers(const char* begin, const char* end) {
+  size_t ans = 0;
+  bool in_number = false;
+  for (const char* p = begin; p < end; p++) {
+    bool blank = IsBlank(*p) || *p == '\n';
+    ans += !blank && !in_number;
+    in_number = !blank;
+  }
+  return ans;
+}
+
+// Runs chunk(k) for every k < bounds.size() - 1, one thread per chunk, and
+// rethrows the first exception of any of them.
+template<class F>
+void ForEachChunk(const std::vector<size_t>& bounds, const F& chunk) {
+  int count = bounds.size() - 1;
+  if (count == 1) {
+    chunk(0);
+    return;
+  }
+  std::vector<std::exception_ptr> errors(count);
+  std::vector<std::thread> threads;
+  threads.reserve(count);
+  for (int k = 0; k < count; k++) {
+    threads.emplace_back([&, k]() {
+      try {
+        chunk(k);
+      } catch (...) {
+        errors[k] = std::current_exception();
+      }
+    });
+  }
+  for (auto& thread: threads) {
+    thread.join();
+  }
+  for (auto& error: errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+// Numbers in every chunk, counted in parallel.
+inline std::vector<size_t> CountChunkNumbers(std::string_view text,
+                                             const std::vector<size_t>& bounds) {
+  std::vector<size_t> counts(bounds.size() - 1);
+  ForEachChunk(bounds, [&](int k) {
+    counts[k] = CountNumbers(text.data() + bounds[k],
+                             text.data() + bounds[k + 1]);
+  });
+  return counts;
+}
+
+inline void CheckMatrixSize(uint64_t n, uint64_t m) {
+  constexpr uint64_t kMaxEntries = std::numeric_limits<int>::max();
+  if (n > kMaxEntries || m > kMaxEntries || n * m > kMaxEntries) {
+    throw std::runtime_error("Matrix of size " +
+                             PairToString(std::make_pair(n, m)) +
+                             " is too large");
+  }
+}
+
+// Collects the numbers of one entry, one for real and two for complex
+// fields, and passes the entry on once it is complete.
+template<class T>
+class EntryBuilder {
+ public:
+  explicit EntryBuilder(bool complex) : parts_(complex ? 2 : 1) {}
+
+  // Returns true when value completes an entry, which is then in entry.
+  bool Add(double value, T* entry) {
+    part_[filled_++] = value;
+    if (filled_ < parts_) {
+      return false;
+    }
+    filled_ = 0;
+    if constexpr (kIsComplex<T>) {
+      *entry = T(part_[0], parts_ == 2 ? part_[1] : 0);
+    } else {
+      *entry = static_cast<T>(part_[0]);
+    }
+    return true;
+  }
+
+  bool Empty() const {
+    return filled_ == 0;
+  }
+
+ private:
+  int parts_;
+  int filled_ = 0;
+  double part_[2];
+};
+
+enum class MarketSymmetry {
+  kGeneral,
+  kSymmetric,
+  kSkewSymmetric,
+  kHermitian,
+};
+
+template<class T>
+T MirrorEntry(T value, MarketSymmetry symmetry) {
+  switch (symmetry) {
+    case MarketSymmetry::kSkewSymmetric:
+      return -value;
+    case MarketSymmetry::kHermitian:
+      if constexpr (kIsComplex<T>) {
+        return std::conj(value);
+      }
+      return value;
+    default:
+      return value;
+  }
+}
+
+// Array entries go column by column; with a symmetry only the lower
+// triangle is stored, without the diagonal when skew-symmetric.
+template<class T>
+void ParseMarketArray(std::string_view text, int n, int m, bool complex,
+                      MarketSymmetry symmetry, int thread_num, Matrix<T>& a) {
+  bool lower = symmetry != MarketSymmetry::kGeneral;
+  int skip = symmetry == MarketSymmetry::kSkewSymmetric ? 1 : 0;
+  if (lower && n != m) {
+    throw std::runtime_error("Symmetric matrix should be square");
+  }
+  auto bounds = SplitAtLines(text, thread_num);
+  auto counts = CountChunkNumbers(text, bounds);
+  int parts = complex ? 2 : 1;
+  std::vector<uint64_t> first_entry(counts.size() + 1);
+  for (int k = 0; k < counts.size(); k++) {
+    if (counts[k] % parts != 0) {
+      throw std::runtime_error("Complex entry without imaginary part");
+    }
+    first_entry[k + 1] = first_entry[k] + counts[k] / parts;
+  }
+  uint64_t expected = 0;
+  for (int j = 0; j < m; j++) {
+    expected += lower ? std::max(0, n - j - skip) : n;
+  }
+  if (first_entry.back() != expected) {
+    throw std::runtime_error("Expected " + std::to_string(expected) +
+                             " entries, got " +
+                             std::to_string(first_entry.back()));
+  }
+  ForEachChunk(bounds, [&](int k) {
+    // Position of the first entry of the chunk, then entries one by one.
+    int i = 0;
+    int j = 0;
+    uint64_t left = first_entry[k];
+    while (j < m) {
+      uint64_t column = lower ? std::max(0, n - j - skip) : n;
+      if (left < column) {
+        i = (lower ? j + skip : 0) + left;
+        break;
+      }
+      left -= column;
+      j++;
+    }
+    EntryBuilder<T> builder(complex);
+    T entry;
+    ScanNumbers(text.data() + bounds[k], text.data() + bounds[k + 1],
+                [&](double value) {
+      if (!builder.Add(value, &entry)) {
+        return;
+      }
+      a(i, j) = entry;
+      if (lower && i != j) {
+        a(j, i) = MirrorEntry(entry, symmetry);
+      }
+      if (++i == n) {
+        j++;
+        i = lower ? j + skip : 0;
+      }
+    }, []() {});
+  });
+}
+
+// Coordinate entries are lines "i j" (pattern), "i j value" or
+// "i j real imaginary", indices 1-based.
+template<class T>
+void ParseMarketCoordinate(std::string_view text, int n, int m,
+                           uint64_t nonzeros, int values,
+                           MarketSymmetry symmetry, int thread_num,
+                           Matrix<T>& a) {
+  bool lower = symmetry != MarketSymmetry::kGeneral;
+  if (lower && n != m) {
+    throw std::runtime_error("Symmetric matrix should be square");
+  }
+  auto bounds = SplitAtLines(text, thread_num);
+  std::vector<uint64_t> entries(bounds.size() - 1);
+  ForEachChunk(bounds, [&](int k) {
+    double line[4];
+    int filled = 0;
+    auto finish = [&]() {
+      if (filled == 0) {
+        return;
+      }
+      if (filled != 2 + values) {
+        throw std::runtime_error("Coordinate entry should have " +
+                                 std::to_string(2 + values) + " numbers");
+      }
+      filled = 0;
+      int i = static_cast<int>(line[0]) - 1;
+      int j = static_cast<int>(line[1]) - 1;
+      if (i < 0 || i >= n || j < 0 || j >= m ||
+          i + 1 != line[0] || j + 1 != line[1]) {
+        throw std::runtime_error(
+            "Entry " + PairToString(std::make_pair(line[0], line[1])) +
+            " outside of the matrix");
+      }
+      T entry;
+      if constexpr (kIsComplex<T>) {
+        entry = values == 0 ? T(1) : T(line[2], values == 2 ? line[3] : 0);
+      } else {
+        entry = values == 0 ? T(1) : static_cast<T>(line[2]);
+      }
+      a(i, j) = entry;
+      if (lower && i != j) {
+        a(j, i) = MirrorEntry(entry, symmetry);
+      }
+      entries[k]++;
+    };
+    ScanNumbers(text.data() + bounds[k], text.data() + bounds[k + 1],
+                [&](double value) {
+      if (filled == 4) {
+        throw std::runtime_error("Too many numbers in a coordinate entry");
+      }
+      line[filled++] = value;
+    }, finish);
+    finish();
+  });
+  uint64_t total = 0;
+  for (auto count: entries) {
+    total += count;
+  }
+  if (total != nonzeros) {
+    throw std::runtime_error("Expected " + std::to_string(nonzeros) +
+                             " entries, got " + std::to_string(total));
+  }
+}
+
+inline std::string ToLower(std::string_view s) {
+  std::string ans(s);
+  for (auto& c: ans) {
+    c = std::tolower(static_cast<unsigned char>(c));
+  }
+  return ans;
+}
+
+// Returns the line at pos without the line end and moves pos past it.
+inline std::string_view NextLine(std::string_view text, size_t& pos) {
+  size_t end = std::min(text.find('\n', pos), text.size());
+  auto line = text.substr(pos, end - pos);
+  pos = std::min(end + 1, text.size());
+  if (!line.empty() && line.back() == '\r') {
+    line.remove_suffix(1);
+  }
+  return line;
+}
+
+template<class T>
+Matrix<T> ParseMatrixMarket(std::string_view text, int thread_num) {
+  size_t pos = 0;
+  std::istringstream banner{std::string(NextLine(text, pos))};
+  std::string magic, object, format, field, symmetry_name;
+  banner >> magic >> object >> format >> field >> symmetry_name;
+  object = ToLower(object);
+  format = ToLower(format);
+  field = ToLower(field);
+  symmetry_name = ToLower(symmetry_name);
+  if (magic != "%%MatrixMarket" || object != "matrix") {
+    throw std::runtime_error("Not a Matrix Market matrix");
+  }
+  MarketSymmetry symmetry;
+  if (symmetry_name == "general") {
+    symmetry = MarketSymmetry::kGeneral;
+  } else if (symmetry_name == "symmetric") {
+    symmetry = MarketSymmetry::kSymmetric;
+  } else if (symmetry_name == "skew-symmetric") {
+    symmetry = MarketSymmetry::kSkewSymmetric;
+  } else if (symmetry_name == "hermitian") {
+    symmetry = MarketSymmetry::kHermitian;
+  } else {
+    throw std::runtime_error("Unknown symmetry " + symmetry_name);
+  }
+  int values;
+  if (field == "pattern") {
+    values = 0;
+  } else if (field == "real" || field == "double" || field == "integer") {
+    values = 1;
+  } else if (field == "complex") {
+    values = 2;
+  } else {
+    throw std::runtime_error("Unknown field " + field);
+  }
+  if (values == 2 && !kIsComplex<T>) {
+    throw std::runtime_error("Complex matrix read into a real one");
+  }
+  if (format != "array" && format != "coordinate") {
+    throw std::runtime_error("Unknown format " + format);
+  }
+  if (format == "array" && values == 0) {
+    throw std::runtime_error("Pattern matrix in array format");
+  }
+  // Comments, then the size line.
+  std::string_view size_line;
+  while (pos < text.size()) {
+    size_line = NextLine(text, pos);
+    auto first = size_line.find_first_not_of(" \t");
+    if (first != std::string_view::npos && size_line[first] != '%') {
+      break;
+    }
+    size_line = {};
+  }
+  std::vector<double> sizes;
+  ScanNumbers(size_line.data(), size_line.data() + size_line.size(),
+              [&](double value) {
+    sizes.push_back(value);
+  }, []() {});
+  size_t size_count = format == "array" ? 2 : 3;
+  if (sizes.size() != size_count ||
+      std::any_of(sizes.begin(), sizes.end(), [](double s) {
+        return s < 0 || s != static_cast<uint64_t>(s);
+      })) {
+    throw std::runtime_error("Bad size line '" + std::string(size_line) + "'");
+  }
+  CheckMatrixSize(sizes[0], sizes[1]);
+  Matrix<T> a(sizes[0], sizes[1]);
+  auto data = text.substr(pos);
+  if (format == "array") {
+    ParseMarketArray(data, a.Rows(), a.Cols(), values == 2, symmetry,
+                     thread_num, a);
+  } else {
+    ParseMarketCoordinate(data, a.Rows(), a.Cols(), sizes[2], values,
+                          symmetry, thread_num, a);
+  }
+  return a;
+}
+
+template<class T>
+Matrix<T> ParseMatrixText(std::string_view text, int thread_num) {
+  int parts = kIsComplex<T> ? 2 : 1;
+  // The first line with numbers gives the number of columns.
+  size_t pos = 0;
+  size_t first_numbers = 0;
+  while (pos < text.size() && first_numbers == 0) {
+    auto line = NextLine(text, pos);
+    first_numbers = CountNumbers(line.data(), line.data() + line.size());
+  }
+  if (first_numbers == 0) {
+    return Matrix<T>();
+  }
+  if (first_numbers % parts != 0) {
+    throw std::runtime_error("Complex entry without imaginary part");
+  }
+  uint64_t cols = first_numbers / parts;
+  auto bounds = SplitAtLines(text, thread_num);
+  auto counts = CountChunkNumbers(text, bounds);
+  std::vector<uint64_t> first_entry(counts.size() + 1);
+  for (int k = 0; k < counts.size(); k++) {
+    first_entry[k + 1] = first_entry[k] + counts[k];
+  }
+  if (first_entry.back() % first_numbers != 0) {
+    throw std::runtime_error("Rows of different length");
+  }
+  uint64_t rows = first_entry.back() / first_numbers;
+  CheckMatrixSize(rows, cols);
+  Matrix<T> a(rows, cols);
+  ForEachChunk(bounds, [&](int k) {
+    uint64_t entry = first_entry[k] / parts;
+    EntryBuilder<T> builder(parts == 2);
+    T value;
+    ScanNumbers(text.data() + bounds[k], text.data() + bounds[k + 1],
+                [&](double number) {
+      if (builder.Add(number, &value)) {
+        a(entry / cols, entry % cols) = value;
+        entry++;
+      }
+    }, [&]() {
+      // Blank lines are skipped, every other one should end a row.
+      if (!builder.Empty() || entry % cols != 0) {
+        throw std::runtime_error("Rows of different length");
+      }
+    });
+  });
+  return a;
+}
+
+}
+
+// Reads a Matrix Market matrix on thread_num threads. Symmetric,
+// skew-symmetric and hermitian files are expanded to the full matrix,
+// pattern entries become ones.
+template<class T>
+Matrix<T> ReadMatrixMarket(const std::string& path, int thread_num = 1) {
+  __internal::TextFile file(path);
+  return __internal::ParseMatrixMarket<T>(file.View(),
+                                          std::max(1, thread_num));
+}
+
+// Reads a matrix written as one row per line with blank separated entries,
+// as numpy.savetxt writes it, on thread_num threads.
+template<class T>
+Matrix<T> ReadMatrixText(const std::string& path, int thread_num = 1) {
+  __internal::TextFile file(path);
+  return __internal::ParseMatrixText<T>(file.View(), std::max(1, thread_num));
+}
+
+namespace __internal {
+
+// Rows [from, to) of a, entries in shortest round trip notation.
+template<class T>
+void AppendTextRows(std::string& out, const Matrix<T>& a, int from, int to) {
+  for (int i = from; i < to; i++) {
+    for (int j = 0; j < a.Cols(); j++) {
+      if (j != 0) {
+        out += ' ';
+      }
+      if constexpr (kIsComplex<T>) {
+        AppendNumber(out, a(i, j).real(), -1);
+        out += ' ';
+        AppendNumber(out, a(i, j).imag(), -1);
+      } else {
+        AppendNumber(out, a(i, j), -1);
+      }
+    }
+    out += '\n';
+  }
+}
+
+// Formats a in blocks of rows, thread_num blocks at a time in parallel, and
+// passes the blocks to write in order.
+template<class T, class Write>
+void FormatTextBlocks(const Matrix<T>& a, int thread_num, const Write& write) {
+  static_assert(kHasToChars<typename ScalarOf<T>::Type>,
+                "Entries should be numbers");
+  int rows_per_block = RowsPerChunk<T>(a.Cols());
+  std::vector<std::string> blocks(thread_num);
+  for (int i = 0; i < a.Rows(); i += rows_per_block * thread_num) {
+    int to = std::min<int64_t>(a.Rows(),
+                               i + int64_t{rows_per_block} * thread_num);
+    std::vector<size_t> bounds;
+    for (int r = i; r < to; r += rows_per_block) {
+      bounds.push_back(r);
+    }
+    bounds.push_back(to);
+    ForEachChunk(bounds, [&](int k) {
+      blocks[k].clear();
+      AppendTextRows(blocks[k], a, bounds[k], bounds[k + 1]);
+    });
+    for (int k = 0; k + 1 < bounds.size(); k++) {
+      write(blocks[k]);
+    }
+  }
+}
+
+}
+
+#ifdef __unix__
+// Writes a as ReadMatrixText reads it back bit for bit: a row per line,
+// entries in shortest round trip notation. Rows are formatted on
+// thread_num threads and written with plain write calls.
+template<class T>
+void WriteMatrixText(int fd, const Matrix<T>& a, int thread_num = 1) {
+  __internal::FormatTextBlocks(a, std::max(1, thread_num),
+                               [fd](std::string_view block) {
+    while (!block.empty()) {
+      auto written = write(fd, block.data(), block.size());
+      if (written < 0 && errno == EINTR) {
+        continue;
+      }
+      if (written < 0) {
+        throw std::runtime_error("Can't write matrix");
+      }
+      block.remove_prefix(written);
+    }
+  });
+}
+#endif
+
+template<class T>
+void WriteMatrixText(const std::string& path, const Matrix<T>& a,
+                     int thread_num = 1) {
+#ifdef __unix__
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("Can't open " + path);
+  }
+  try {
+    WriteMatrixText(fd, a, thread_num);
+  } catch (...) {
+    close(fd);
+    throw;
+  }
+  if (close(fd) != 0) {
+    throw std::runtime_error("Can't write matrix");
+  }
+#else
+  std::ofstream out(path, std::ios::binary);
+  if (!out.is_open()) {
+    throw std::runtime_error("Can't open " + path);
+  }
+  __internal::FormatTextBlocks(a, std::max(1, thread_num),
+                               [&out](std::string_view block) {
+    out.write(block.data(), block.size());
+  });
+  if (!out) {
+    throw std::runtime_error("Can't write matrix");
+  }
+#endif
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <complex>
+#include <stdexcept>
+#include "matrix.h"
+
+// Complex matrix kept as two real matrices, the real parts and the
+// imaginary parts. Kernels on it are loops over plain T in both planes,
+// which the compiler vectorizes, where Matrix<std::complex<T>> goes through
+// a std::complex operator call per entry. A real matrix times a split one
+// is two real products: the real matrix is never made complex.
+template<class T>
+class SplitComplexMatrix {
+ public:
+  SplitComplexMatrix() = default;
+  SplitComplexMatrix(int n, int m) : re_(n, m), im_(n, m) {}
+  SplitComplexMatrix(const Matrix<T>& re, const Matrix<T>& im)
+      : re_(re), im_(im) {
+    AssertEqualSizes(re, im);
+  }
+  // Zero imaginary parts.
+  explicit SplitComplexMatrix(const Matrix<T>& re)
+      : re_(re), im_(re.Rows(), re.Cols()) {}
+  explicit SplitComplexMatrix(const Matrix<std::complex<T>>& a)
+      : re_(a.Rows(), a.Cols()), im_(a.Rows(), a.Cols()) {
+    for (int i = 0; i < a.Rows(); i++) {
+      for (int j = 0; j < a.Cols(); j++) {
+        re_.At(i, j) = a.At(i, j).real();
+        im_.At(i, j) = a.At(i, j).imag();
+      }
+    }
+  }
+
+  int Rows() const {
+    return re_.Rows();
+  }
+
+  int Cols() const {
+    return re_.Cols();
+  }
+
+  std::pair<int, int> Size() const {
+    return re_.Size();
+  }
+
+  bool IsSquare() const {
+    return re_.IsSquare();
+  }
+
+  bool IsColVector() const {
+    return re_.IsColVector();
+  }
+
+  Matrix<T>& Real() {
+    return re_;
+  }
+
+  const Matrix<T>& Real() const {
+    return re_;
+  }
+
+  Matrix<T>& Imag() {
+    return im_;
+  }
+
+  const Matrix<T>& Imag() const {
+    return im_;
+  }
+
+  std::complex<T> At(int i, int j) const {
+    return {re_.At(i, j), im_.At(i, j)};
+  }
+
+  // The same matrix interleaved.
+  Matrix<std::complex<T>> ToComplex() const {
+    Matrix<std::complex<T>> ans(Rows(), Cols());
+    for (int i = 0; i < Rows(); i++) {
+      for (int j = 0; j < Cols(); j++) {
+        ans.At(i, j) = At(i, j);
+      }
+    }
+    return ans;
+  }
+
+ private:
+  Matrix<T> re_;
+  Matrix<T> im_;
+};
+
+namespace __internal {
+
+inline constexpr int kProductLanes = 4;
+
+// Sets *re + i *im to the sum of a_k (xr_k + i xi_k) over count entries, a
+// contiguous, the parts re_stride and im_stride apart. kProductLanes
+// accumulators per part, as in AddSquares, let the compiler use vector
+// lanes for contiguous parts.
+template<class T>
+void SplitDot(const T* a, const T* xr, int re_stride, const T* xi,
+              int im_stride, int count, T* re, T* im) {
+  T res[kProductLanes] = {};
+  T ims[kProductLanes] = {};
+  int k = 0;
+  if (re_stride == 1 && im_stride == 1) {
+    for (; k + kProductLanes <= count; k += kProductLanes) {
+      for (int lane = 0; lane < kProductLanes; lane++) {
+        res[lane] += a[k + lane] * xr[k + lane];
+        ims[lane] += a[k + lane] * xi[k + lane];
+      }
+    }
+  }
+  for (; k < count; k++) {
+    res[0] += a[k] * xr[size_t(k) * re_stride];
+    ims[0] += a[k] * xi[size_t(k) * im_stride];
+  }
+  *re = 0;
+  *im = 0;
+  for (int lane = 0; lane < kProductLanes; lane++) {
+    *re += res[lane];
+    *im += ims[lane];
+  }
+}
+
+}
+
+// lhs * rhs into result, which has to be of the size of the product and
+// apart from both. A column rhs takes one dot product per row and part,
+// a wider one row updates over both planes.
+template<class T>
+void MultiplyInto(const Matrix<T>& lhs, const SplitComplexMatrix<T>& rhs,
+                  SplitComplexMatrix<T>& result) {
+  if (lhs.Cols() != rhs.Rows() ||
+      result.Size() != std::make_pair(lhs.Rows(), rhs.Cols())) {
+    throw std::runtime_error(
+        "Bad matrix sizes " + PairToString(lhs.Size()) + " "
+            + PairToString(rhs.Size()) + " " + PairToString(result.Size()));
+  }
+  int n = lhs.Rows();
+  int p = lhs.Cols();
+  int m = rhs.Cols();
+  COUNT_WORK(2 * __internal::Flops<T>::kMultiplyAdd * uint64_t(n) * p * m,
+             sizeof(T) * (uint64_t(n) * p + 2 * uint64_t(p) * m +
+                 2 * uint64_t(n) * m));
+  const Matrix<T>& xr = rhs.Real();
+  const Matrix<T>& xi = rhs.Imag();
+  for (int i = 0; i < n; i++) {
+    if (p == 0) {
+      for (int j = 0; j < m; j++) {
+        result.Real().At(i, j) = T();
+        result.Imag().At(i, j) = T();
+      }
+      continue;
+    }
+    const T* a = &lhs.At(i, 0);
+    if (m == 1) {
+      __internal::SplitDot(a, &xr.At(0, 0), xr.RowStride(), &xi.At(0, 0),
+                           xi.RowStride(), p, &result.Real().At(i, 0),
+                           &result.Imag().At(i, 0));
+      continue;
+    }
+    T* re = &result.Real().At(i, 0);
+    T* im = &result.Imag().At(i, 0);
+    for (int j = 0; j < m; j++) {
+      re[j] = T();
+      im[j] = T();
+    }
+    for (int k = 0; k < p; k++) {
+      T factor = a[k];
+      const T* row_re = &xr.At(k, 0);
+      const T* row_im = &xi.At(k, 0);
+      for (int j = 0; j < m; j++) {
+        re[j] += factor * row_re[j];
+        im[j] += factor * row_im[j];
+      }
+    }
+  }
+}
+
+template<class T>
+SplitComplexMatrix<T> operator*(const Matrix<T>& lhs,
+                                const SplitComplexMatrix<T>& rhs) {
+  if (lhs.Cols() != rhs.Rows()) {
+    throw std::runtime_error(
+        "Bad matrix sizes " + PairToString(lhs.Size()) + " "
+            + PairToString(rhs.Size()));
+  }
+  SplitComplexMatrix<T> result(lhs.Rows(), rhs.Cols());
+  MultiplyInto(lhs, rhs, result);
+  return result;
+}
+
+// Real times interleaved complex, through the split product.
+template<class T>
+Matrix<std::complex<T>> operator*(const Matrix<T>& lhs,
+                                  const Matrix<std::complex<T>>& rhs) {
+  return (lhs * SplitComplexMatrix<T>(rhs)).ToComplex();
+}
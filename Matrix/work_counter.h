@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <complex>
+#include <cstdint>
+
+// Work done by the Matrix operations and the Algebra kernels: real floating
+// point operations and the bytes of operands they read and write once each.
+// The byte count is the compulsory traffic of a kernel, not what the caches
+// actually move; it is what arithmetic intensity is usually quoted against.
+struct WorkSample {
+  uint64_t flops = 0;
+  uint64_t bytes = 0;
+
+  double ArithmeticIntensity() const {
+    return bytes == 0 ? 0 : static_cast<double>(flops) / bytes;
+  }
+
+  WorkSample& operator+=(const WorkSample& other) {
+    flops += other.flops;
+    bytes += other.bytes;
+    return *this;
+  }
+};
+
+// Totals over all threads. Kernels add once per call or per loop, never per
+// element, so relaxed atomics are cheap enough.
+class WorkCounter {
+ public:
+  static void Add(uint64_t flops, uint64_t bytes) {
+    flops_.fetch_add(flops, std::memory_order_relaxed);
+    bytes_.fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+  static WorkSample Get() {
+    return {flops_.load(std::memory_order_relaxed),
+            bytes_.load(std::memory_order_relaxed)};
+  }
+
+ private:
+  static inline std::atomic<uint64_t> flops_{0};
+  static inline std::atomic<uint64_t> bytes_{0};
+};
+
+// Adds the work done during its lifetime to *sample.
+class ScopedWorkCounter {
+ public:
+  explicit ScopedWorkCounter(WorkSample* sample)
+      : sample_(sample), start_(WorkCounter::Get()) {}
+
+  ~ScopedWorkCounter() {
+    auto end = WorkCounter::Get();
+    sample_->flops += end.flops - start_.flops;
+    sample_->bytes += end.bytes - start_.bytes;
+  }
+
+ private:
+  WorkSample* sample_;
+  WorkSample start_;
+};
+
+namespace __internal {
+
+// Real flops of one addition and one multiplication of T.
+template<class T>
+struct Flops {
+  static constexpr uint64_t kAdd = 1;
+  static constexpr uint64_t kMultiply = 1;
+  static constexpr uint64_t kMultiplyAdd = kAdd + kMultiply;
+};
+
+template<class T>
+struct Flops<std::complex<T>> {
+  static constexpr uint64_t kAdd = 2;
+  static constexpr uint64_t kMultiply = 6;
+  static constexpr uint64_t kMultiplyAdd = kAdd + kMultiply;
+};
+
+}
+
+// Counting is compiled in only when the build defines
+// LINEAR_ALGEBRA_COUNT_WORK.
+#ifdef LINEAR_ALGEBRA_COUNT_WORK
+#define COUNT_WORK(flops, bytes) \
+  WorkCounter::Add(static_cast<uint64_t>(flops), static_cast<uint64_t>(bytes))
+#else
+#define COUNT_WORK(flops, bytes) ((void) 0)
+#endif
@@ -14,7 +14,27 @@ void Plot::AddPlotLine(PlotLine plot_line) {
   lines_.push_back(std::move(plot_line));
 }
 
-std::string Plot::ToString() {
+const std::string& Plot::GetName() const {
+  return name_;
+}
+
+const std::string& Plot::GetXLabel() const {
+  return x_label_;
+}
+
+const std::string& Plot::GetYLabel() const {
+  return y_label_;
+}
+
+const std::vector<int>& Plot::GetXs() const {
+  return xs_;
+}
+
+const std::vector<PlotLine>& Plot::GetLines() const {
+  return lines_;
+}
+
+std::string Plot::ToString() const {
   std::stringstream ss;
   ss << name_ << '\n' << x_label_ << '\n' << y_label_ << '\n';
   for (auto x: xs_) {
@@ -24,11 +44,7 @@ std::string Plot::ToString() {
   for (const auto& line: lines_) {
     ss << line.GetName() << '\n';
     for (auto x: xs_) {
-      if (line.GetValues().count(x) != 0) {
-        ss << line.GetValues().at(x);
-      } else {
-        ss << -1;
-      }
+      ss << line.GetValue(x).value_or(-1);
       ss << ' ';
     }
     ss << '\n';
@@ -11,7 +11,13 @@ class Plot {
 
   void AddPlotLine(PlotLine plot_line);
 
-  std::string ToString();
+  const std::string& GetName() const;
+  const std::string& GetXLabel() const;
+  const std::string& GetYLabel() const;
+  const std::vector<int>& GetXs() const;
+  const std::vector<PlotLine>& GetLines() const;
+
+  std::string ToString() const;
 
  private:
   std::string name_;
@@ -1,18 +1,41 @@
+#include <algorithm>
 #include "plot_line.h"
 
+namespace {
+
+bool LessX(const std::pair<int, double>& value, int x) {
+  return value.first < x;
+}
+
+}
+
 PlotLine::PlotLine(std::string name) : name_(std::move(name)) {}
 
-std::map<int, double>& PlotLine::GetValues() {
+const std::vector<std::pair<int, double>>& PlotLine::GetValues() const {
   return values_;
 }
 
-const std::map<int, double>& PlotLine::GetValues() const {
-  return values_;
+std::optional<double> PlotLine::GetValue(int x) const {
+  auto it = std::lower_bound(values_.begin(), values_.end(), x, LessX);
+  if (it == values_.end() || it->first != x) {
+    return std::nullopt;
+  }
+  return it->second;
 }
+
 const std::string& PlotLine::GetName() const {
   return name_;
 }
 
 void PlotLine::AddValue(int x, double y) {
-  values_[x] = y;
+  if (values_.empty() || values_.back().first < x) {
+    values_.emplace_back(x, y);
+    return;
+  }
+  auto it = std::lower_bound(values_.begin(), values_.end(), x, LessX);
+  if (it->first == x) {
+    it->second = y;
+  } else {
+    values_.emplace(it, x, y);
+  }
 }
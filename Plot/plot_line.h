@@ -1,18 +1,21 @@
 #pragma once
 
+#include <optional>
 #include <string>
+#include <utility>
 #include <vector>
-#include <map>
 
+// Values sorted by x. Lines are usually filled in increasing x, which only
+// appends.
 class PlotLine {
  public:
   explicit PlotLine(std::string name);
-  std::map<int, double>& GetValues();
-  const std::map<int, double>& GetValues() const;
+  const std::vector<std::pair<int, double>>& GetValues() const;
+  std::optional<double> GetValue(int x) const;
   const std::string& GetName() const;
   void AddValue(int x, double y);
 
  private:
   std::string name_;
-  std::map<int, double> values_;
+  std::vector<std::pair<int, double>> values_;
 };
@@ -0,0 +1,96 @@
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include "plot_writer.h"
+
+namespace {
+
+uint32_t PaddedSize(size_t size) {
+  return (size + 7) / 8 * 8;
+}
+
+uint32_t StringSize(const std::string& s) {
+  return PaddedSize(sizeof(uint32_t) + s.size());
+}
+
+void WritePadding(std::ostream& out, size_t size) {
+  static const char zeros[8]{};
+  out.write(zeros, PaddedSize(size) - size);
+}
+
+void WriteChunkHeader(std::ostream& out, const char* tag, uint32_t size) {
+  out.write(tag, 4);
+  out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+}
+
+void WriteString(std::ostream& out, const std::string& s) {
+  uint32_t size = s.size();
+  out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+  out.write(s.data(), s.size());
+  WritePadding(out, sizeof(size) + s.size());
+}
+
+}
+
+PlotWriter::PlotWriter(std::ostream& out) : out_(out) {}
+
+void PlotWriter::BeginPlot(const std::string& name,
+                           const std::string& x_label,
+                           const std::string& y_label,
+                           const std::vector<int>& xs) {
+  xs_ = xs;
+  begun_ = true;
+  uint32_t header[2]{static_cast<uint32_t>(xs.size()), 0};
+  auto xs_size = xs.size() * sizeof(int32_t);
+  WriteChunkHeader(out_, "PLOT",
+                   sizeof(header) + StringSize(name) + StringSize(x_label)
+                       + StringSize(y_label) + PaddedSize(xs_size));
+  out_.write(reinterpret_cast<const char*>(header), sizeof(header));
+  WriteString(out_, name);
+  WriteString(out_, x_label);
+  WriteString(out_, y_label);
+  std::vector<int32_t> column(xs.begin(), xs.end());
+  out_.write(reinterpret_cast<const char*>(column.data()), xs_size);
+  WritePadding(out_, xs_size);
+}
+
+void PlotWriter::AppendLine(const PlotLine& line) {
+  if (!begun_) {
+    throw std::runtime_error("Line '" + line.GetName() + "' has no plot");
+  }
+  std::vector<double> column(xs_.size());
+  for (int i = 0; i < xs_.size(); i++) {
+    column[i] = line.GetValue(xs_[i]).value_or(
+        std::numeric_limits<double>::quiet_NaN());
+  }
+  auto ys_size = column.size() * sizeof(double);
+  WriteChunkHeader(out_, "LINE", StringSize(line.GetName()) + ys_size);
+  WriteString(out_, line.GetName());
+  out_.write(reinterpret_cast<const char*>(column.data()), ys_size);
+  out_.flush();
+}
+
+void PlotWriter::Write(const Plot& plot) {
+  BeginPlot(plot.GetName(), plot.GetXLabel(), plot.GetYLabel(), plot.GetXs());
+  for (const auto& line: plot.GetLines()) {
+    AppendLine(line);
+  }
+}
+
+void WritePlotCsv(std::ostream& out, const Plot& plot) {
+  out << plot.GetXLabel();
+  for (const auto& line: plot.GetLines()) {
+    out << ',' << line.GetName();
+  }
+  out << '\n';
+  for (auto x: plot.GetXs()) {
+    out << x;
+    for (const auto& line: plot.GetLines()) {
+      out << ',';
+      if (auto y = line.GetValue(x)) {
+        out << *y;
+      }
+    }
+    out << '\n';
+  }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <ostream>
+#include "plot.h"
+
+// Writes plots column by column in a binary layout that can be appended to
+// while a sweep is running and read back without parsing (see results.py).
+// The file is a sequence of chunks, each a 4 byte tag, a uint32 payload size
+// and the payload padded to 8 bytes, all in native byte order:
+//   PLOT: uint32 n, uint32 0, name, x label, y label, int32 xs[n]
+//   LINE: name, double ys[n] for the xs of the last PLOT, NaN where missing
+// Strings are a uint32 length followed by the bytes.
+class PlotWriter {
+ public:
+  explicit PlotWriter(std::ostream& out);
+
+  void BeginPlot(const std::string& name,
+                 const std::string& x_label,
+                 const std::string& y_label,
+                 const std::vector<int>& xs);
+  void AppendLine(const PlotLine& line);
+
+  void Write(const Plot& plot);
+
+ private:
+  std::ostream& out_;
+  std::vector<int> xs_;
+  bool begun_ = false;
+};
+
+// One row per x with a column per line, missing values left empty.
+void WritePlotCsv(std::ostream& out, const Plot& plot);
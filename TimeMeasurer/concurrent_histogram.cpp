@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+#include "concurrent_histogram.h"
+
+namespace {
+
+std::atomic<int> next_thread{0};
+
+int ThreadIndex() {
+  thread_local int index = next_thread.fetch_add(1, std::memory_order_relaxed);
+  return index;
+}
+
+}
+
+uint64_t HistogramSnapshot::Count() const {
+  uint64_t ans = 0;
+  for (auto count: counts) {
+    ans += count;
+  }
+  return ans;
+}
+
+double HistogramSnapshot::Mean() const {
+  auto n = Count();
+  if (n == 0) {
+    return 0;
+  }
+  double sum = 0;
+  for (int i = 0; i < counts.size(); i++) {
+    sum += static_cast<double>(counts[i]) * i;
+  }
+  return sum / n;
+}
+
+double HistogramSnapshot::Variance() const {
+  auto n = Count();
+  if (n < 2) {
+    return 0;
+  }
+  auto mean = Mean();
+  double sum = 0;
+  for (int i = 0; i < counts.size(); i++) {
+    sum += counts[i] * (i - mean) * (i - mean);
+  }
+  return sum / (n - 1);
+}
+
+int HistogramSnapshot::Quantile(double q) const {
+  auto n = Count();
+  if (n == 0) {
+    return -1;
+  }
+  auto need = std::max<uint64_t>(1, std::ceil(std::clamp(q, 0., 1.) * n));
+  uint64_t seen = 0;
+  for (int i = 0; i < counts.size(); i++) {
+    seen += counts[i];
+    if (seen >= need) {
+      return i;
+    }
+  }
+  return counts.size() - 1;
+}
+
+int HistogramSnapshot::Min() const {
+  return Quantile(0);
+}
+
+int HistogramSnapshot::Max() const {
+  return Quantile(1);
+}
+
+ConcurrentHistogram::ConcurrentHistogram(int bins, int shards)
+    : bins_(bins),
+      shards_(shards > 0
+              ? shards
+              : std::max<int>(1, std::thread::hardware_concurrency())),
+      lines_per_shard_((bins + kLineSize - 1) / kLineSize) {
+  if (bins <= 0) {
+    throw std::invalid_argument("Histogram should have at least one bin");
+  }
+  lines_ = std::make_unique<Line[]>(shards_ * lines_per_shard_);
+}
+
+std::atomic<uint64_t>& ConcurrentHistogram::Counter(int shard, int bin) const {
+  return lines_[shard * lines_per_shard_ + bin / kLineSize]
+      .counts[bin % kLineSize];
+}
+
+void ConcurrentHistogram::Add(int64_t value) {
+  auto bin = std::clamp<int64_t>(value, 0, bins_ - 1);
+  auto shard = ThreadIndex() % shards_;
+  Counter(shard, bin).fetch_add(1, std::memory_order_relaxed);
+}
+
+int ConcurrentHistogram::Bins() const {
+  return bins_;
+}
+
+HistogramSnapshot ConcurrentHistogram::Snapshot() const {
+  HistogramSnapshot ans{std::vector<uint64_t>(bins_)};
+  for (int shard = 0; shard < shards_; shard++) {
+    for (int i = 0; i < bins_; i++) {
+      ans.counts[i] += Counter(shard, i).load(std::memory_order_relaxed);
+    }
+  }
+  return ans;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Counts of integer samples in bins [0, bins) with the statistics derived from
+// them. Mean and variance are taken over the bins in two passes, so they stay
+// exact where running sums would cancel.
+struct HistogramSnapshot {
+  std::vector<uint64_t> counts;
+
+  uint64_t Count() const;
+  double Mean() const;
+  double Variance() const;
+  // Smallest bin holding at least a q-th part of the samples, -1 when empty.
+  int Quantile(double q) const;
+  int Min() const;
+  int Max() const;
+};
+
+// Histogram shared by many threads. Every thread adds into its own shard of
+// relaxed atomic counters, shards are cache line aligned, so adding never
+// locks and rarely shares a line. Snapshot sums the shards and can be taken
+// while the threads are still adding; it then sees some recent samples and
+// misses others, which is enough for progress reports. Samples outside the
+// range are clamped into the first or the last bin. Memory is
+// O(shards * bins) whatever the number of samples.
+class ConcurrentHistogram {
+ public:
+  explicit ConcurrentHistogram(int bins, int shards = 0);
+
+  void Add(int64_t value);
+  int Bins() const;
+  HistogramSnapshot Snapshot() const;
+
+ private:
+  static constexpr int kLineSize = 64 / sizeof(uint64_t);
+
+  struct alignas(64) Line {
+    std::atomic<uint64_t> counts[kLineSize]{};
+  };
+
+  std::atomic<uint64_t>& Counter(int shard, int bin) const;
+
+  int bins_;
+  int shards_;
+  int lines_per_shard_;
+  std::unique_ptr<Line[]> lines_;
+};
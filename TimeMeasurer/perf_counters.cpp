@@ -0,0 +1,150 @@
+#include "perf_counters.h"
+
+#ifdef __linux__
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+double PerfSample::InstructionsPerCycle() const {
+  return cycles == 0 ? 0 : static_cast<double>(instructions) / cycles;
+}
+
+double PerfSample::CacheMissRate() const {
+  return cache_references == 0
+         ? 0 : static_cast<double>(cache_misses) / cache_references;
+}
+
+PerfSample& PerfSample::operator+=(const PerfSample& other) {
+  valid = valid && other.valid;
+  cycles += other.cycles;
+  instructions += other.instructions;
+  cache_references += other.cache_references;
+  cache_misses += other.cache_misses;
+  branch_misses += other.branch_misses;
+  return *this;
+}
+
+#ifdef __linux__
+
+namespace {
+
+int OpenEvent(uint64_t config, int group_fd) {
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  attr.disabled = group_fd == -1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+      PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+}
+
+PerfCounters::PerfCounters() {
+  const uint64_t configs[kEventCount]{
+      PERF_COUNT_HW_CPU_CYCLES,
+      PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_CACHE_REFERENCES,
+      PERF_COUNT_HW_CACHE_MISSES,
+      PERF_COUNT_HW_BRANCH_MISSES,
+  };
+  for (int i = 0; i < kEventCount; i++) {
+    fds_[i] = OpenEvent(configs[i], group_fd_);
+    if (fds_[i] == -1) {
+      Close();
+      return;
+    }
+    if (i == 0) {
+      group_fd_ = fds_[0];
+    }
+  }
+}
+
+PerfCounters::~PerfCounters() {
+  Close();
+}
+
+void PerfCounters::Close() {
+  for (auto& fd: fds_) {
+    if (fd != -1) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  group_fd_ = -1;
+}
+
+bool PerfCounters::Available() const {
+  return group_fd_ != -1;
+}
+
+void PerfCounters::Start() {
+  if (!Available()) {
+    return;
+  }
+  ioctl(group_fd_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(group_fd_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+PerfSample PerfCounters::Stop() {
+  PerfSample sample;
+  if (!Available()) {
+    return sample;
+  }
+  ioctl(group_fd_, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+  // nr, time_enabled, time_running, then one value per event.
+  uint64_t data[3 + kEventCount];
+  if (read(group_fd_, data, sizeof(data)) != sizeof(data) || data[2] == 0) {
+    return sample;
+  }
+  // The group is scheduled as a whole, scale for multiplexing.
+  double scale = static_cast<double>(data[1]) / data[2];
+  uint64_t* values = data + 3;
+  sample.valid = true;
+  sample.cycles = values[0] * scale;
+  sample.instructions = values[1] * scale;
+  sample.cache_references = values[2] * scale;
+  sample.cache_misses = values[3] * scale;
+  sample.branch_misses = values[4] * scale;
+  return sample;
+}
+
+#else
+
+PerfCounters::PerfCounters() = default;
+
+PerfCounters::~PerfCounters() = default;
+
+void PerfCounters::Close() {}
+
+bool PerfCounters::Available() const {
+  return false;
+}
+
+void PerfCounters::Start() {}
+
+PerfSample PerfCounters::Stop() {
+  return {};
+}
+
+#endif
+
+ScopedPerfCounters::ScopedPerfCounters(PerfCounters& counters,
+                                       PerfSample* sample)
+    : counters_(counters), sample_(sample) {
+  counters_.Start();
+}
+
+ScopedPerfCounters::~ScopedPerfCounters() {
+  auto sample = counters_.Stop();
+  if (sample_) {
+    *sample_ += sample;
+  }
+}
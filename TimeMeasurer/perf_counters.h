@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+
+// Hardware counter values of one measured region. valid is false when the
+// counters could not be opened, then only the wall time is meaningful. A sum
+// stays valid only while every added sample is, so start it from {true}.
+struct PerfSample {
+  bool valid = false;
+  uint64_t cycles = 0;
+  uint64_t instructions = 0;
+  uint64_t cache_references = 0;
+  uint64_t cache_misses = 0;
+  uint64_t branch_misses = 0;
+
+  double InstructionsPerCycle() const;
+  double CacheMissRate() const;
+
+  PerfSample& operator+=(const PerfSample& other);
+};
+
+// Counters of the calling thread read through perf_event_open, user space
+// only. Opening fails without a Linux kernel or when perf_event_paranoid
+// forbids it; Available() then returns false and Stop() returns an invalid
+// sample, so callers can always fall back to timing.
+class PerfCounters {
+ public:
+  PerfCounters();
+  ~PerfCounters();
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  bool Available() const;
+
+  void Start();
+  PerfSample Stop();
+
+ private:
+  static constexpr int kEventCount = 5;
+
+  void Close();
+
+  int group_fd_ = -1;
+  int fds_[kEventCount]{-1, -1, -1, -1, -1};
+};
+
+// Adds the counters of its lifetime to *sample.
+class ScopedPerfCounters {
+ public:
+  ScopedPerfCounters(PerfCounters& counters, PerfSample* sample);
+  ~ScopedPerfCounters();
+
+ private:
+  PerfCounters& counters_;
+  PerfSample* sample_;
+};
@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "scoped_profiler.h"
+
+namespace {
+
+std::mutex trees_mutex;
+std::vector<std::shared_ptr<Profiler::ThreadTree>> trees;
+
+struct MergedNode {
+  std::string name;
+  int64_t total_ns = 0;
+  int64_t calls = 0;
+  std::vector<MergedNode> children{};
+};
+
+void Merge(const Profiler::ThreadTree& tree, int node, MergedNode& merged) {
+  merged.total_ns += tree.nodes[node].total_ns;
+  merged.calls += tree.nodes[node].calls;
+  for (auto child: tree.nodes[node].children) {
+    const char* name = tree.nodes[child].name;
+    auto it = std::find_if(merged.children.begin(), merged.children.end(),
+                           [name](const MergedNode& m) {
+                             return m.name == name;
+                           });
+    if (it == merged.children.end()) {
+      merged.children.push_back({name});
+      it = std::prev(merged.children.end());
+    }
+    Merge(tree, child, *it);
+  }
+}
+
+void Print(std::ostream& out, const MergedNode& node, int depth) {
+  int64_t children_ns = 0;
+  for (const auto& child: node.children) {
+    children_ns += child.total_ns;
+  }
+  out << std::left << std::setw(40)
+      << std::string(2 * depth, ' ') + node.name
+      << std::right << std::fixed << std::setprecision(6)
+      << std::setw(14) << node.total_ns * 1e-9
+      << std::setw(14) << (node.total_ns - children_ns) * 1e-9
+      << std::setw(12) << node.calls << '\n';
+  for (const auto& child: node.children) {
+    Print(out, child, depth + 1);
+  }
+}
+
+}
+
+Profiler::ThreadTree& Profiler::ThisThread() {
+  thread_local std::shared_ptr<ThreadTree> tree = [] {
+    auto tree = std::make_shared<ThreadTree>();
+    std::lock_guard<std::mutex> lock(trees_mutex);
+    trees.push_back(tree);
+    return tree;
+  }();
+  return *tree;
+}
+
+void Profiler::Report(std::ostream& out) {
+  MergedNode root;
+  {
+    std::lock_guard<std::mutex> lock(trees_mutex);
+    for (const auto& tree: trees) {
+      Merge(*tree, 0, root);
+    }
+  }
+  out << std::left << std::setw(40) << "zone"
+      << std::right << std::setw(14) << "total, s"
+      << std::setw(14) << "self, s"
+      << std::setw(12) << "calls" << '\n';
+  for (const auto& child: root.children) {
+    Print(out, child, 0);
+  }
+}
+
+void Profiler::Reset() {
+  std::lock_guard<std::mutex> lock(trees_mutex);
+  for (auto& tree: trees) {
+    for (auto& node: tree->nodes) {
+      node.total_ns = 0;
+      node.calls = 0;
+    }
+  }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <vector>
+
+// Call tree of named zones. Every thread accumulates into its own tree
+// without locking; Report merges the trees of all threads by zone path, so
+// it should be called once the worker threads are joined.
+class Profiler {
+ public:
+  struct Node {
+    const char* name = "";
+    int parent = -1;
+    std::vector<int> children{};
+    int64_t total_ns = 0;
+    int64_t calls = 0;
+  };
+
+  struct ThreadTree {
+    std::vector<Node> nodes{{"", -1}};  // Node 0 is the root
+    int current = 0;
+
+    int Enter(const char* name);
+    void Leave(int node, int64_t ns);
+  };
+
+  static ThreadTree& ThisThread();
+
+  // Total and self time of every zone summed over all threads.
+  static void Report(std::ostream& out);
+  static void Reset();
+};
+
+class ScopedZone {
+ public:
+  explicit ScopedZone(const char* name);
+  ~ScopedZone();
+
+  ScopedZone(const ScopedZone&) = delete;
+  ScopedZone& operator=(const ScopedZone&) = delete;
+
+ private:
+  Profiler::ThreadTree& tree_;
+  int node_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+// Zones cost nothing unless the build defines LINEAR_ALGEBRA_PROFILE.
+#ifdef LINEAR_ALGEBRA_PROFILE
+#define PROFILE_ZONE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_ZONE_CONCAT(a, b) PROFILE_ZONE_CONCAT_IMPL(a, b)
+#define PROFILE_ZONE(name) \
+  ScopedZone PROFILE_ZONE_CONCAT(profile_zone_, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name) ((void) 0)
+#endif
+
+inline int Profiler::ThreadTree::Enter(const char* name) {
+  for (auto child: nodes[current].children) {
+    if (nodes[child].name == name || std::strcmp(nodes[child].name, name) == 0) {
+      current = child;
+      return child;
+    }
+  }
+  int node = nodes.size();
+  nodes.push_back({name, current});
+  nodes[current].children.push_back(node);
+  current = node;
+  return node;
+}
+
+inline void Profiler::ThreadTree::Leave(int node, int64_t ns) {
+  nodes[node].total_ns += ns;
+  nodes[node].calls++;
+  current = nodes[node].parent;
+}
+
+inline ScopedZone::ScopedZone(const char* name)
+    : tree_(Profiler::ThisThread()),
+      node_(tree_.Enter(name)),
+      start_(std::chrono::steady_clock::now()) {}
+
+inline ScopedZone::~ScopedZone() {
+  auto duration = std::chrono::steady_clock::now() - start_;
+  tree_.Leave(node_, std::chrono::duration_cast<std::chrono::nanoseconds>(
+      duration).count());
+}
@@ -2,36 +2,30 @@ import matplotlib.pyplot as plt
 import numpy as np
 import sys
 
-lines = open(sys.argv[1], "r").read()
+from results import read_plots
+
+plots = read_plots(sys.argv[1])
 step = int(sys.argv[2])
 
-plot_count = len(lines.strip().split("===")) - 1
+plot_count = len(plots)
 fig = plt.figure(figsize=(15 * plot_count, 5))
 plot_num = 1
 
-for plot in lines.strip().split("==="):
-    if len(plot) == 0:
-        break
-    plot = plot.strip().split('\n')
-    name = plot[0]
-    x_label = plot[1]
-    y_label = plot[2]
-    xs = np.array([int(i) for i in plot[3].strip().split(' ')])[::step]
+for plot in plots:
+    xs = plot["xs"][::step]
 
     ax = fig.add_subplot(1, plot_count, plot_num)
     # ax.set_xticklabels(xs)
     ax.set_xticks(xs)
-    ax.title.set_text(name)
+    ax.title.set_text(plot["name"])
     ax.set_xticklabels([f'{i}-{i+step}' for i in xs[:-1]] + [f'>{xs[-1]}'])
-    ax.set_xlabel(x_label)
-    ax.set_ylabel(y_label)
+    ax.set_xlabel(plot["x_label"])
+    ax.set_ylabel(plot["y_label"])
 
-    for i in range(4, len(plot), 2):
-        line_name = plot[i]
-        y = np.array([float(j) for j in plot[i + 1].strip().split(' ')])
+    for line_name, y in plot["lines"]:
         ys = []
         for j in range(0, len(y), step):
-            ys.append(np.sum(y[j:j + step]))
+            ys.append(np.nansum(y[j:j + step]))
         ax.bar(xs, ys, label=line_name, width=30)
 
     plot_num += 1
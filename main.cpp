@@ -1,9 +1,11 @@
+#include <cstdio>
 #include <iostream>
 #include <fstream>
 #include <mutex>
 #include <shared_mutex>
 #include <thread>
 #include "Matrix/matrix.h"
+#include "Matrix/counter_random.h"
 #include "Algebra/gauss.h"
 #include "Algebra/euclidean_norm.h"
 #include "Algebra/hessenberg_form.h"
@@ -15,7 +17,14 @@
 #include "Algebra/polynomial.h"
 #include "Algebra/danilevski_eigenvalues.h"
 #include "Algebra/polynomial_roots.h"
+#include "Algebra/companion_qr.h"
+#include "Algebra/continuation.h"
+#include "Algebra/exact_characteristic_polynomial.h"
+#include "Benchmark/sweep_runner.h"
+#include "Benchmark/test_corpus.h"
 #include "Plot/plot.h"
+#include "Plot/plot_writer.h"
+#include "TimeMeasurer/concurrent_histogram.h"
 #include "TimeMeasurer/time_measurer.h"
 
 DMatrix Matrix1() {
@@ -55,7 +64,72 @@ DMatrix Matrix2() {
        {0, -1, -1, 1, -1, 1, -1, -1, -1, 1, 1, -1, 0, -1, -1, 0, 1, 0, -1, -1}};
 }
 
-void Task1(double min, double max, int seed) {
+// Seeds of the first count matrices of the given size on which method
+// converges, i.e. reports iters > 0. Candidates are run in batches, every
+// shard waiting for the whole batch, until there are enough of them.
+std::vector<int> ConvergingSeeds(
+    SweepRunner& runner,
+    int size,
+    const std::string& method,
+    int count,
+    int thread_num,
+    const std::function<SweepMetrics(const SweepCell&)>& body) {
+  std::vector<int> seeds;
+  for (int first = 0; seeds.size() < count; first += thread_num) {
+    std::vector<SweepCell> cells;
+    for (int i = first; i < first + thread_num; i++) {
+      cells.push_back({size, i, method});
+    }
+    runner.Run(cells, body, thread_num);
+    runner.WaitFor(cells);
+    for (const auto& cell: cells) {
+      if ((*runner.Find(cell))["iters"] > 0 && seeds.size() < count) {
+        seeds.push_back(cell.seed);
+      }
+    }
+  }
+  return seeds;
+}
+
+// The first count random matrices of the given size that pass check, taken
+// from the corpus where they were generated and checked before. Candidates
+// are checked in parallel batches of thread_num.
+std::vector<CorpusEntry> ValidatedMatrices(
+    TestCorpus& corpus,
+    const std::string& check_name,
+    int size,
+    int count,
+    double min,
+    double max,
+    int seed,
+    int thread_num,
+    const std::function<CorpusOutcome(const DMatrix&)>& check) {
+  std::vector<CorpusEntry> ans;
+  for (int first = seed; ans.size() < count; first += thread_num) {
+    std::vector<CorpusEntry> batch(thread_num);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_num; i++) {
+      threads.emplace_back([&, i]() {
+        CorpusKey key{"random", check_name, size, first + i, min, max};
+        batch[i] = corpus.GetOrCreate(key, [&]() {
+          return DMatrix::Random(size, size, min, max, first + i, true);
+        }, check);
+      });
+    }
+    for (auto& thread: threads) {
+      thread.join();
+    }
+    for (auto& entry: batch) {
+      if (entry.outcome.iters > 0 && ans.size() < count) {
+        ans.push_back(std::move(entry));
+      }
+    }
+  }
+  return ans;
+}
+
+void Task1(double min, double max, int seed,
+           int shard = 0, int shard_count = 1) {
   // {
   //   int iters = 0;
   //   auto ans = PowerMethodEigenvalues(Matrix1(), &iters, 1000);
@@ -75,74 +149,75 @@ void Task1(double min, double max, int seed) {
   std::vector<int> sizes{10, 50, 100, 200, 400, 800, 1000};
   int tests_count = 5;
   int max_iter = 1e3;
-  std::vector<std::vector<DMatrix>> v;
-  std::shared_mutex mutex;
   int thread_num = 11;
-  std::cout << "Generating matrices...\n";
-  auto thread_main = [&](int size, int id) {
-    while (true) {
-      mutex.lock_shared();
-      if (v.back().size() >= tests_count) {
-        mutex.unlock_shared();
-        break;
-      }
-      mutex.unlock_shared();
-
-      auto a = DMatrix::Random(size, size, min, max, seed + id);
-      int iter = -1;
-      PowerMethodEigenvalues(a, &iter, max_iter, 20, 5., 0);
-
-      if (iter > 0) {
-        mutex.lock();
-        v.back().push_back(a);
-        std::cout << "!\n";
-        mutex.unlock();
-      }
-    }
+  SweepRunner runner("../task1_checkpoint.txt", shard, shard_count);
+  auto matrix = [&](const SweepCell& cell) {
+    return CounterRandomMatrix(cell.size, cell.size, min, max, seed,
+                               cell.seed);
   };
+  std::cout << "Generating matrices...\n";
+  std::vector<std::vector<int>> seeds;
   for (auto size: sizes) {
-    v.emplace_back();
-    std::vector<std::thread> threads;
-    threads.reserve(thread_num);
     std::cout << size << '\n';
-    for (int i = 0; i < thread_num; i++) {
-      threads.emplace_back(thread_main, size, i);
-    }
-    for (auto& thread: threads) {
-      thread.join();
-    }
-    while (v.back().size() > tests_count) {
-      v.back().pop_back();
+    seeds.push_back(ConvergingSeeds(
+        runner, size, "filter", tests_count, thread_num,
+        [&](const SweepCell& cell) {
+          int iter = -1;
+          PowerMethodEigenvalues(matrix(cell), &iter, max_iter, 20, 5., 0);
+          return SweepMetrics{{"iters", iter}};
+        }));
+  }
+
+  std::vector<std::string> methods{"Mod 1", "Mod 2", "Mod 3", "Auto"};
+  std::vector<SweepCell> cells;
+  for (int i = 0; i < sizes.size(); i++) {
+    for (auto cell_seed: seeds[i]) {
+      for (int method_ind = 0; method_ind < methods.size(); ++method_ind) {
+        cells.push_back({sizes[i], cell_seed, std::to_string(method_ind)});
+      }
     }
-    std::cout << v.back().size() << '\n';
+  }
+  // Timed one at a time: concurrent solves share memory bandwidth and
+  // turbo, and their times would not compare with earlier results.
+  runner.Run(cells, [&](const SweepCell& cell) {
+    auto m = matrix(cell);
+    TimeMeasurer time_measurer;
+    int iter;
+    PowerMethodEigenvalues(m, &iter, 2 * max_iter, 20, 5.,
+                           std::stoi(cell.method));
+    return SweepMetrics{{"iters", iter},
+                        {"time", time_measurer.GetDuration()}};
+  });
+  runner.Reload();
+  if (!runner.IsComplete(cells)) {
+    std::cout << "Other shards are not finished, rerun to plot\n";
+    return;
   }
 
   Plot times_plot("Times", "size", "time", sizes);
   Plot iters_plot("Iters", "size", "iters", sizes);
 
-  std::vector<std::string> methods{"Mod 1", "Mod 2", "Mod 3", "Auto"};
   for (int method_ind = 0; method_ind < methods.size(); ++method_ind) {
     PlotLine times_line(methods[method_ind]);
     PlotLine iters_line(methods[method_ind]);
     for (int i = 0; i < sizes.size(); i++) {
       double time = 0;
       int iters = 0;
-      for (const auto& m: v[i]) {
-        TimeMeasurer time_measurer;
-        int iter;
-        PowerMethodEigenvalues(m, &iter, 2 * max_iter, 20, 5., method_ind);
+      for (auto cell_seed: seeds[i]) {
+        auto metrics = *runner.Find(
+            {sizes[i], cell_seed, std::to_string(method_ind)});
+        int iter = metrics["iters"];
         if (iter < 0) {
           std::cerr << "Not converge" << '\n';
           iter = 1000 * max_iter;
         }
         iters += iter;
-        time += time_measurer.GetDuration();
+        time += metrics["time"];
       }
       iters /= tests_count;
       time /= tests_count;
       times_line.AddValue(sizes[i], time);
       iters_line.AddValue(sizes[i], iters);
-      std::cout << sizes[i] << '\n';
     }
     times_plot.AddPlotLine(times_line);
     iters_plot.AddPlotLine(iters_line);
@@ -155,60 +230,26 @@ void Task1_(double min, double max, int seed) {
   std::vector<int> sizes{10, 50, 100, 200, 400, 800, 1000};
   int tests_count = 5;
   int max_iter = 1e3;
-  std::vector<std::vector<DMatrix>> v;
-  std::shared_mutex mutex;
   int thread_num = 12;
   auto converge_eps = 5.;
   int check_algo = 2;
+  TestCorpus corpus("../task1_corpus.bin");
   std::cout << "Generating matrices...\n";
-  auto thread_main = [&](int size, int id) {
-    while (true) {
-      mutex.lock_shared();
-      if (v.back().size() >= tests_count) {
-        mutex.unlock_shared();
-        break;
-      }
-      mutex.unlock_shared();
-
-      auto a = DMatrix::Random(size, size, min, max, seed + id);
-      int iter = -1;
-      auto x = PowerMethodEigenvalues(a, &iter, max_iter, 20, 5., check_algo);
-
-      bool ok = iter > 0 && !x.empty();
-      // for (auto [lambda, u]: x) {
-      //   if (!ok) {
-      //     break;
-      //   }
-      //   if (std::abs(EuclideanNorm<std::complex<double>> (
-      //       a.ToComplex() * u - std::sqrt(std::abs(lambda)) * u)) > converge_eps) {
-      //     ok = false;
-      //     break;
-      //   }
-      // }
-
-      if (ok) {
-        mutex.lock();
-        v.back().push_back(a);
-        std::cout << "!\n";
-        mutex.unlock();
-      }
-    }
-  };
+  std::vector<std::vector<CorpusEntry>> v;
   for (auto size: sizes) {
-    v.emplace_back();
-    std::vector<std::thread> threads;
-    threads.reserve(thread_num);
     std::cout << size << '\n';
-    for (int i = 0; i < thread_num; i++) {
-      threads.emplace_back(thread_main, size, i);
-    }
-    for (auto& thread: threads) {
-      thread.join();
-    }
-    while (v.back().size() > tests_count) {
-      v.back().pop_back();
-    }
-    std::cout << v.back().size() << '\n';
+    v.push_back(ValidatedMatrices(
+        corpus, "power" + std::to_string(check_algo) + "_found_" +
+            std::to_string(max_iter),
+        size, tests_count, min, max, seed, thread_num,
+        [&](const DMatrix& a) {
+          TimeMeasurer time_measurer;
+          int iter = -1;
+          auto x = PowerMethodEigenvalues(a, &iter, max_iter, 20, 5.,
+                                          check_algo);
+          return CorpusOutcome{x.empty() ? -1 : iter,
+                               time_measurer.GetDuration()};
+        }));
   }
 
   Plot times_plot("Times", "size", "time", sizes);
@@ -221,7 +262,9 @@ void Task1_(double min, double max, int seed) {
     for (int i = 0; i < sizes.size(); i++) {
       double time = 0;
       int iters = 0;
-      for (const auto& m: v[i]) {
+      // The check ran on thread_num threads at once; every method is timed
+      // here, one run at a time.
+      for (const auto& [m, outcome]: v[i]) {
         TimeMeasurer time_measurer;
         int iter;
         PowerMethodEigenvalues(
@@ -247,51 +290,46 @@ void Task1_(double min, double max, int seed) {
 }
 
 PlotLine Task1__(double min, double max, int seed,
-                 int algorithm, int max_iter) {
+                 int algorithm, int max_iter,
+                 PowerAcceleration acceleration = PowerAcceleration::kNone,
+                 const std::string& name = "") {
   int size = 120;
   int count = 100;
   int thread_num = 11;
   std::vector<std::thread> threads;
-  std::vector<std::vector<int>> thread_ans;
-  auto thread_main = [&](
-      std::vector<int>& v, int id) {
+  ConcurrentHistogram histogram(max_iter + 1, thread_num);
+  auto thread_main = [&](int id) {
     for (int i = 0; i < count; i++) {
-      if (i == 0) {
-        DMatrix::Random(0, 0, 0, 0, seed + id, true);
-      }
-      auto a = DMatrix::Random(size, size, min, max);
+      auto a = CounterRandomMatrix(size, size, min, max, seed,
+                                   (id - 1) * count + i);
       int iter = 0;
-      auto vv = PowerMethodEigenvalues(a, &iter, max_iter, 10, 5., algorithm);
+      auto vv = PowerMethodEigenvalues(a, &iter, max_iter, 10, 5., algorithm,
+                                       nullptr, acceleration);
       for (const auto& it: vv) {
         if (std::abs(EuclideanNorm<std::complex<double>>(
-            a.ToComplex() * it.second - it.first * it.second)) > 10) {
+            a * it.second - it.first * it.second)) > 10) {
           iter = -1;
         }
       }
       if (iter < 0) {
         iter = max_iter;
       }
-      iter = std::min(iter, max_iter);
-      v[iter]++;
+      histogram.Add(iter);
       if ((i + 1) % 10 == 0) {
-        std::cout << id << ": " << i + 1 << '\n';
+        auto snapshot = histogram.Snapshot();
+        std::cout << id << ": " << i + 1 << ", total " << snapshot.Count()
+                  << ", median " << snapshot.Quantile(0.5) << '\n';
       }
     }
   };
-  thread_ans.resize(thread_num, std::vector<int>(max_iter + 1));
   for (int i = 0; i < thread_num; i++) {
-    threads.emplace_back(thread_main, std::ref(thread_ans[i]), i + 1);
+    threads.emplace_back(thread_main, i + 1);
   }
   for (auto& thread: threads) {
     thread.join();
   }
-  std::vector<int> ans(max_iter + 1);
-  for (int i = 0; i < ans.size(); i++) {
-    for (auto& thread_answer: thread_ans) {
-      ans[i] += thread_answer[i];
-    }
-  }
-  PlotLine line(std::to_string(algorithm));
+  auto ans = histogram.Snapshot().counts;
+  PlotLine line(name.empty() ? std::to_string(algorithm) : name);
   for (int i = 0; i < ans.size(); i++) {
     line.AddValue(i, ans[i]);
   }
@@ -301,46 +339,21 @@ PlotLine Task1__(double min, double max, int seed,
 void Task1__Optimize(double min, double max, int seed, int max_iter) {
   std::vector<int> sizes{10, 50, 100, 200, 400, 800, 1000};
   int tests_count = 10;
-  std::vector<std::vector<DMatrix>> v;
-  std::shared_mutex mutex;
   int thread_num = 11;
+  TestCorpus corpus("../task1_corpus.bin");
   std::cout << "Generating matrices...\n";
-  auto thread_main = [&](int size, int id) {
-    while (true) {
-      mutex.lock_shared();
-      if (v.back().size() >= tests_count) {
-        mutex.unlock_shared();
-        break;
-      }
-      mutex.unlock_shared();
-
-      auto a = DMatrix::Random(size, size, min, max, seed + id);
-      int iter = -1;
-      PowerMethodEigenvalues(a, &iter, max_iter, 20, 5., 2);
-
-      if (iter > 0) {
-        mutex.lock();
-        v.back().push_back(a);
-        std::cout << "!\n";
-        mutex.unlock();
-      }
-    }
-  };
+  std::vector<std::vector<CorpusEntry>> v;
   for (auto size: sizes) {
-    v.emplace_back();
-    std::vector<std::thread> threads;
-    threads.reserve(thread_num);
     std::cout << size << '\n';
-    for (int i = 0; i < thread_num; i++) {
-      threads.emplace_back(thread_main, size, i);
-    }
-    for (auto& thread: threads) {
-      thread.join();
-    }
-    while (v.back().size() > tests_count) {
-      v.back().pop_back();
-    }
-    std::cout << v.back().size() << '\n';
+    v.push_back(ValidatedMatrices(
+        corpus, "power2_" + std::to_string(max_iter),
+        size, tests_count, min, max, seed, thread_num,
+        [&](const DMatrix& a) {
+          TimeMeasurer time_measurer;
+          int iter = -1;
+          PowerMethodEigenvalues(a, &iter, max_iter, 20, 5., 2);
+          return CorpusOutcome{iter, time_measurer.GetDuration()};
+        }));
   }
 
   Plot times_plot("Times", "size", "time", sizes);
@@ -353,7 +366,9 @@ void Task1__Optimize(double min, double max, int seed, int max_iter) {
       {
         double time = 0;
         int iters = 0;
-        for (const auto& m: v[i]) {
+        // Timed again, serially as the optimized runs: the check ran on
+        // thread_num threads at once.
+        for (const auto& [m, outcome]: v[i]) {
           TimeMeasurer time_measurer;
           int iter;
           __internal::PowerMethodEigenvalues3(m,
@@ -374,7 +389,7 @@ void Task1__Optimize(double min, double max, int seed, int max_iter) {
       {
         double time = 0;
         int iters = 0;
-        for (const auto& m: v[i]) {
+        for (const auto& [m, outcome]: v[i]) {
           TimeMeasurer time_measurer;
           int iter;
           __internal::PowerMethodEigenvalues3(m,
@@ -406,12 +421,15 @@ void Task1__Full(double min, double max, int seed) {
   int max_iter = 2000;
   std::vector<int> xs(max_iter + 1);
   std::iota(xs.begin(), xs.end(), 0);
-  Plot plot("Plot", "Iters", "Count", xs);
+  std::ofstream out("../task1_plot3.bin", std::ios::binary);
+  PlotWriter writer(out);
+  writer.BeginPlot("Plot", "Iters", "Count", xs);
   for (int i = 0; i <= 2; i++) {
-    plot.AddPlotLine(Task1__(min, max, seed, i, max_iter));
+    writer.AppendLine(Task1__(min, max, seed, i, max_iter));
   }
-  std::ofstream out("../task1_plot3.txt");
-  out << plot.ToString();
+  // Aitken and Wynn change only the returned value, not the iterations.
+  writer.AppendLine(Task1__(min, max, seed, 0, max_iter,
+                            PowerAcceleration::kChebyshev, "0 Chebyshev"));
 }
 
 void Task3Bar(double min, double max, int seed, int max_iter) {
@@ -423,47 +441,39 @@ void Task3Bar(double min, double max, int seed, int max_iter) {
   int count = 2000;
   int thread_num = 11;
   std::vector<std::thread> threads;
-  std::vector<std::vector<int>> thread_ans;
-  auto thread_main = [&](
-      std::vector<int>& v, int id) {
+  ConcurrentHistogram histogram(max_iter + 1, thread_num);
+  auto thread_main = [&](int id) {
     for (int i = 0; i < count; i++) {
-      if (i == 0) {
-        DMatrix::Random(0, 0, 0, 0, seed + id, true);
-      }
-      auto a = DMatrix::Random(size, size, min, max);
+      auto a = CounterRandomMatrix(size, size, min, max, seed,
+                                   (id - 1) * count + i);
       int iter = 0;
       auto vv =
           QrAlgorithm(ReflectionsHessenberg(a), &iter, max_iter);
       if (iter < 0) {
         iter = max_iter;
       }
-      iter = std::min(iter, max_iter);
-      v[iter]++;
+      histogram.Add(iter);
       if ((i + 1) % 100 == 0) {
-        std::cout << id << ": " << i + 1 << '\n';
+        auto snapshot = histogram.Snapshot();
+        std::cout << id << ": " << i + 1 << ", total " << snapshot.Count()
+                  << ", mean " << snapshot.Mean() << '\n';
       }
     }
   };
-  thread_ans.resize(thread_num, std::vector<int>(max_iter + 1));
   for (int i = 0; i < thread_num; i++) {
-    threads.emplace_back(thread_main, std::ref(thread_ans[i]), i + 1);
+    threads.emplace_back(thread_main, i + 1);
   }
   for (auto& thread: threads) {
     thread.join();
   }
-  std::vector<int> ans(max_iter + 1);
-  for (int i = 0; i < ans.size(); i++) {
-    for (auto& thread_answer: thread_ans) {
-      ans[i] += thread_answer[i];
-    }
-  }
+  auto ans = histogram.Snapshot().counts;
   PlotLine line("QR");
   for (int i = 0; i < ans.size(); i++) {
     line.AddValue(i, ans[i]);
   }
   plot.AddPlotLine(line);
-  std::ofstream out("../task3_bar.txt");
-  out << plot.ToString();
+  std::ofstream out("../task3_bar.bin", std::ios::binary);
+  PlotWriter(out).Write(plot);
 }
 
 template<class T>
@@ -476,14 +486,14 @@ void TestQrAlgorithm(const Matrix<T>& a) {
   for (auto r: qr_ans) {
     complex_roots.emplace_back(r);
   }
-  auto vectors = FindEigenvectorsByValues(a.ToComplex(), complex_roots);
+  auto vectors = FindEigenvectorsByValues(a, complex_roots);
   for (int i = 0; i < vectors.size(); ++i) {
     std::cout << qr_ans[i] << '\n';
     // if (vectors[i].Rows() != 0) {
       std::cout << vectors[i];
       std::cout << "Norm: " <<
                 std::abs(EuclideanNorm<std::complex<T>>(
-                    a.ToComplex() * vectors[i] - qr_ans[i] * vectors[i]));
+                    a * vectors[i] - qr_ans[i] * vectors[i]));
     // }
     std::cout << "\n#########\n";
   }
@@ -500,7 +510,7 @@ void TestPowerMethod(const Matrix<T>& a) {
     // std::cout << e << '\n';
     std::cout << "Norm: " <<
               std::abs(EuclideanNorm<std::complex<T>>(
-                  a.ToComplex() * v - e * v));
+                  a * v - e * v));
     std::cout << '\n' << std::abs(EuclideanNorm<std::complex<T>>(v));
     std::cout << "\n#########\n";
   }
@@ -509,8 +519,7 @@ void TestPowerMethod(const Matrix<T>& a) {
 
 template<class T>
 void TestDanilevskiMethod(const Matrix<T>& a) {
-  std::vector<std::vector<std::tuple
-                              <RowOperation, int, int, T>>> operations;
+  FrobeniusOperations<T> operations;
   auto ff = FrobeniusForm(a, &operations);
   // std::cerr << ff;
   // std::cerr << ff.Row(0);
@@ -530,7 +539,7 @@ void TestDanilevskiMethod(const Matrix<T>& a) {
     for (auto it: r) {
       roots.push_back(it);
     }
-    auto v = EigenVectorsForFrobeniusForm(a.Rows(), shift, matrix_sizes[i], operations[i], r);
+    auto v = EigenVectorsForFrobeniusForm(a.Rows(), shift, matrix_sizes[i], operations, i, r);
     shift += matrix_sizes[i];
     for (auto it: v) {
       vectors.push_back(it);
@@ -544,7 +553,7 @@ void TestDanilevskiMethod(const Matrix<T>& a) {
     std::cerr << r << ' ' << ValueIn(PolynomialMultiply(polynomial), r) << '\n';
   }
 
-  // auto vectors = FindEigenvectorsByValues(a.ToComplex(), complex_roots);
+  // auto vectors = FindEigenvectorsByValues(a, complex_roots);
   for (int i = 0; i < vectors.size(); ++i) {
     if (vectors[i].Rows() == 0) {
       continue;
@@ -558,6 +567,81 @@ void TestDanilevskiMethod(const Matrix<T>& a) {
   std::cout << "===================\n\n\n";
 }
 
+template<class T>
+void TestDanilevskiCompanionQr(const Matrix<T>& a) {
+  auto ff = FrobeniusForm(a);
+  std::vector<int> matrix_sizes;
+  int iters = 0;
+  auto blocks = DanilevskiCompanionQr(ff, &matrix_sizes, &iters);
+  std::cout << "Danilevski companion QR eigenvalues:\n";
+  for (int i = 0; i < blocks.size(); i++) {
+    std::cout << "Block of size " << matrix_sizes[i] << ":\n";
+    for (auto value: blocks[i]) {
+      std::cout << value << '\n';
+    }
+  }
+  std::cout << "Iters: " << iters << "\n===================\n\n\n";
+}
+
+// Follows the dominant eigenvalues of a + 0.05 s b, s = 0, ..., steps - 1,
+// with EigenContinuation and prints the steps where they differ from those
+// of a cold SubspaceIteration run to a tighter eps. On most such sweeps the
+// dominant eigenvalue changes hands on the way.
+template<class T>
+void TestEigenContinuation(const Matrix<T>& a, const Matrix<T>& b,
+                           int steps) {
+  EigenContinuation<T> continuation;
+  int mismatches = 0;
+  int warm_iters = 0;
+  int cold_iters = 0;
+  for (int s = 0; s < steps; s++) {
+    auto m = a + b * (0.05 * s);
+    int warm = 0;
+    int cold = 0;
+    auto found = continuation.Dominant(m, &warm, 1000);
+    auto expected = SubspaceIteration(m, &cold, 10000, 4, T(1e-10));
+    warm_iters += warm;
+    cold_iters += cold;
+    bool ok = warm >= 0 && found.size() == expected.size();
+    for (int k = 0; ok && k < found.size(); k++) {
+      ok = std::abs(found[k].first - expected[k].first) <=
+           1e-4 * std::abs(expected[k].first);
+    }
+    if (!ok) {
+      mismatches++;
+      std::cout << "Step " << s << ':';
+      for (const auto& [e, v]: found) {
+        std::cout << ' ' << e;
+      }
+      std::cout << " instead of";
+      for (const auto& [e, v]: expected) {
+        std::cout << ' ' << e;
+      }
+      std::cout << '\n';
+    }
+  }
+  std::cout << "Mismatches: " << mismatches << ", iters: " << warm_iters
+            << " warm, " << cold_iters << " cold\n===================\n\n\n";
+}
+
+template<class T>
+void TestExactCharacteristicPolynomial(const Matrix<T>& a) {
+  auto exact = ExactCharacteristicPolynomial(a);
+  auto polynomial = PolynomialMultiply(DanilevskiPolynomial(FrobeniusForm(a)));
+  std::cout << "Exact characteristic polynomial:\n";
+  long double max_error = 0;
+  for (int i = 0; i < exact.size(); i++) {
+    auto value = exact[i].ToLongDouble();
+    std::cout << exact[i] << '\n';
+    if (i < polynomial.size()) {
+      max_error = std::max(max_error, std::abs(polynomial[i] - value) /
+          std::max(1.0L, std::abs(value)));
+    }
+  }
+  std::cout << "Danilevski relative error: " << max_error
+            << "\n===================\n\n\n";
+}
+
 void Task2Frob(double min, double max, int seed, int count) {
   std::vector<int> sizes{50, 100, 500, 1000};
   Plot times_plot("Times", "size", "time", sizes);
@@ -611,74 +695,43 @@ void Task2Dan(double min, double max, int seed, int count) {
   out << times_plot.ToString();
 }
 
-void Task3(double min, double max, int seed) {
+void Task3(double min, double max, int seed,
+           int shard = 0, int shard_count = 1) {
   std::vector<int> sizes{10, 50, 100, 200, 250};
   int tests_count = 5;
   int max_iter = 600000;
-  std::vector<std::vector<DMatrix>> v;
-  std::shared_mutex mutex;
   int thread_num = 12;
-  std::cout << "Generating matrices...\n";
-  auto thread_main = [&](int size, int id) {
-    while (true) {
-      mutex.lock_shared();
-      if (v.back().size() >= tests_count) {
-        mutex.unlock_shared();
-        break;
-      }
-      mutex.unlock_shared();
-
-      auto a = DMatrix::Random(size, size, min, max, seed + id);
-      int iter = -1;
-      auto x =
-          QrAlgorithm(ReflectionsHessenberg(a), &iter, max_iter);
+  SweepRunner runner("../task3_checkpoint.txt", shard, shard_count);
+  Plot times_plot("Times", "size", "time", sizes);
 
-      if (iter > 0) {
-        mutex.lock();
-        v.back().push_back(a);
-        std::cout << "!\n";
-        mutex.unlock();
-      }
-    }
+  auto qr = [&](const SweepCell& cell) {
+    auto a = CounterRandomMatrix(cell.size, cell.size, min, max, seed,
+                                 cell.seed);
+    TimeMeasurer time_measurer;
+    int iter = -1;
+    QrAlgorithm(ReflectionsHessenberg(a), &iter, max_iter);
+    return SweepMetrics{{"iters", iter},
+                        {"time", time_measurer.GetDuration()}};
   };
+  PlotLine times_line("QR");
   for (auto size: sizes) {
-    v.emplace_back();
-    std::vector<std::thread> threads;
-    threads.reserve(thread_num);
     std::cout << size << '\n';
-    for (int i = 0; i < thread_num; i++) {
-      threads.emplace_back(thread_main, size, i);
+    auto seeds = ConvergingSeeds(runner, size, "qr", tests_count, thread_num,
+                                 qr);
+    // The parallel search only picks the matrices, the times come from
+    // runs one at a time.
+    std::vector<SweepCell> timed;
+    for (auto cell_seed: seeds) {
+      timed.push_back({size, cell_seed, "qr_serial"});
     }
-    for (auto& thread: threads) {
-      thread.join();
-    }
-    while (v.back().size() > tests_count) {
-      v.back().pop_back();
-    }
-    std::cout << v.back().size() << '\n';
-  }
-
-  Plot times_plot("Times", "size", "time", sizes);
-
-  PlotLine times_line("QR");
-  for (int i = 0; i < sizes.size(); i++) {
+    runner.Run(timed, qr);
+    runner.WaitFor(timed);
     double time = 0;
-    int iters = 0;
-    for (const auto& m: v[i]) {
-      TimeMeasurer time_measurer;
-      int iter;
-      QrAlgorithm(ReflectionsHessenberg(m), &iter, max_iter);
-      if (iter < 0) {
-        std::cerr << "Not converge" << '\n';
-        iter = 1000 * max_iter;
-      }
-      iters += iter;
-      time += time_measurer.GetDuration();
+    for (const auto& cell: timed) {
+      time += (*runner.Find(cell))["time"];
     }
-    iters /= tests_count;
     time /= tests_count;
-    times_line.AddValue(sizes[i], time);
-    std::cout << sizes[i] << '\n';
+    times_line.AddValue(size, time);
   }
   times_plot.AddPlotLine(times_line);
 
@@ -686,7 +739,16 @@ void Task3(double min, double max, int seed) {
   out << times_plot.ToString();
 }
 
-int main() {
+int main(int argc, char** argv) {
+  // Sweeps can be split between processes started with "<shard>/<count>".
+  int shard = 0;
+  int shard_count = 1;
+  if (argc > 1 && std::sscanf(argv[1], "%d/%d", &shard, &shard_count) != 2) {
+    std::cerr << "Usage: " << argv[0] << " [shard/shard_count]\n";
+    return 1;
+  }
+
+
   auto eps = 1e-6;
   auto prec = 6;
   Matrix<double>::SetEps(eps, prec);
@@ -715,7 +777,7 @@ int main() {
   //   return 0;
   // }
 
-  // Task1(-10, 10, 8917293);
+  // Task1(-10, 10, 8917293, shard, shard_count);
   // Task1_(-10, 10, 8917293);
   // Task1__Full(-100, 100, 123634);
   // Task1__Optimize(-100, 100, 12335123, 1e3);
@@ -723,7 +785,9 @@ int main() {
   // Task2Frob(-100, 100, 8917293, 3);
   // Task2Dan(-100, 100, 8917293, 4);
 
-  // Task3(-100, 100, 8917293);
+  // TestEigenContinuation(CounterRandomMatrix(80, 80, -1., 1., 3),
+  //                       CounterRandomMatrix(80, 80, -1., 1., 3, 1), 30);
+  // Task3(-100, 100, 8917293, shard, shard_count);
   Task3Bar(-100, 100, 8917293, 2000);
   return 0;
 
@@ -761,6 +825,8 @@ int main() {
 
     TestQrAlgorithm(a);
     // TestDanilevskiMethod(a);
+    // TestDanilevskiCompanionQr(a);
+    // TestExactCharacteristicPolynomial(a);
     // TestPowerMethod(a);
   }
 }
@@ -1,31 +1,25 @@
 import matplotlib.pyplot as plt
 import sys
 
-lines = open(sys.argv[1], "r").read()
+from results import read_plots
 
-plot_count = len(lines.strip().split("===")) - 1
+plots = read_plots(sys.argv[1])
+
+plot_count = len(plots)
 fig = plt.figure(figsize=(5 * plot_count, 5))
 plot_num = 1
 
-for plot in lines.strip().split("==="):
-    if len(plot) == 0:
-        break
-    plot = plot.strip().split('\n')
-    name = plot[0]
-    x_label = plot[1]
-    y_label = plot[2]
-    xs = [int(i) for i in plot[3].strip().split(' ')]
+for plot in plots:
+    xs = plot["xs"]
 
     ax = fig.add_subplot(1, plot_count, plot_num)
     # ax.set_xticklabels(xs)
     ax.set_xticks(xs)
-    ax.title.set_text(name)
-    ax.set_xlabel(x_label)
-    ax.set_ylabel(y_label)
+    ax.title.set_text(plot["name"])
+    ax.set_xlabel(plot["x_label"])
+    ax.set_ylabel(plot["y_label"])
 
-    for i in range(4, len(plot), 2):
-        line_name = plot[i]
-        y = [float(j) for j in plot[i + 1].strip().split(' ')]
+    for line_name, y in plot["lines"]:
         ax.plot(xs, y, label=line_name)
 
     plot_num += 1
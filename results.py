@@ -0,0 +1,66 @@
+import mmap
+import struct
+
+import numpy as np
+
+
+def _read_string(buffer, offset):
+    size = struct.unpack_from("<I", buffer, offset)[0]
+    value = bytes(buffer[offset + 4:offset + 4 + size]).decode()
+    return value, offset + (4 + size + 7) // 8 * 8
+
+
+def _read_binary(buffer):
+    # Columns are numpy views of the mapped file, nothing is copied.
+    plots = []
+    offset = 0
+    while offset + 8 <= len(buffer):
+        tag = bytes(buffer[offset:offset + 4])
+        size = struct.unpack_from("<I", buffer, offset + 4)[0]
+        pos = offset + 8
+        if tag == b"PLOT":
+            n = struct.unpack_from("<I", buffer, pos)[0]
+            name, pos = _read_string(buffer, pos + 8)
+            x_label, pos = _read_string(buffer, pos)
+            y_label, pos = _read_string(buffer, pos)
+            xs = np.frombuffer(buffer, dtype=np.int32, count=n, offset=pos)
+            plots.append({"name": name, "x_label": x_label,
+                          "y_label": y_label, "xs": xs, "lines": []})
+        elif tag == b"LINE":
+            name, pos = _read_string(buffer, pos)
+            n = len(plots[-1]["xs"])
+            ys = np.frombuffer(buffer, dtype=np.float64, count=n, offset=pos)
+            plots[-1]["lines"].append((name, ys))
+        else:
+            raise ValueError(f"Unknown chunk {tag!r} at {offset}")
+        offset += 8 + size
+    return plots
+
+
+def _read_text(text):
+    plots = []
+    for plot in text.strip().split("==="):
+        if len(plot) == 0:
+            break
+        plot = plot.strip().split('\n')
+        lines = []
+        for i in range(4, len(plot), 2):
+            ys = np.array([float(j) for j in plot[i + 1].strip().split(' ')])
+            ys[ys == -1] = np.nan
+            lines.append((plot[i], ys))
+        plots.append({"name": plot[0], "x_label": plot[1],
+                      "y_label": plot[2],
+                      "xs": np.array([int(i) for i in
+                                      plot[3].strip().split(' ')]),
+                      "lines": lines})
+    return plots
+
+
+def read_plots(path):
+    """Plots written by PlotWriter or by Plot::ToString, missing values NaN."""
+    with open(path, "rb") as f:
+        if f.read(4) != b"PLOT":
+            f.seek(0)
+            return _read_text(f.read().decode())
+        buffer = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+    return _read_binary(memoryview(buffer))